@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Counts heap allocations, opt in with -DTETR_COUNT_ALLOCS
+//
+// This replaces the global operator new, so only one translation unit can
+// include it. Thats fine since every exe here is a single .cpp
+
+namespace alloc_counter {
+
+#ifdef TETR_COUNT_ALLOCS
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+// per thread so threads dont fight over one counter
+inline thread_local long allocations = 0;
+
+inline long count() { return allocations; }
+
+// Allocations per frame, broken down by the systems wrapped in
+// begin_system / end_system. Prints any frame that allocated at all, steady
+// state gameplay should never print
+struct Report {
+  struct Entry {
+    const char *name;
+    long allocations;
+  };
+
+  long frame = 0;
+  long frame_start = 0;
+  long system_start = 0;
+  // fixed size so keeping the report doesnt allocate
+  std::array<Entry, 64> systems{};
+  size_t num_systems = 0;
+
+  void begin_frame() {
+    frame++;
+    num_systems = 0;
+    frame_start = count();
+  }
+
+  void begin_system() { system_start = count(); }
+
+  void end_system(const char *name) {
+    long n = count() - system_start;
+    if (n > 0 && num_systems < systems.size())
+      systems[num_systems++] = Entry{name, n};
+  }
+
+  void end_frame() {
+    long n = count() - frame_start;
+    if (n == 0)
+      return;
+    std::cout << "frame " << frame << " allocated " << n << " times:";
+    for (size_t i = 0; i < num_systems; i++)
+      std::cout << " " << systems[i].name << "=" << systems[i].allocations;
+    std::cout << std::endl;
+  }
+};
+
+} // namespace alloc_counter
+
+#ifdef TETR_COUNT_ALLOCS
+namespace alloc_counter {
+// kept out of line so gcc cant see new is malloc and delete is free, it
+// would warn about every new/delete pair as mismatched
+[[gnu::noinline]] inline void *allocate(std::size_t n, std::size_t align) {
+  allocations++;
+  n = n ? n : 1;
+  if (align <= alignof(std::max_align_t))
+    return std::malloc(n);
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(align, (n + align - 1) / align * align);
+}
+
+[[gnu::noinline]] inline void release(void *p) noexcept { std::free(p); }
+
+inline void *allocate_or_throw(std::size_t n, std::size_t align) {
+  if (void *p = allocate(n, align))
+    return p;
+  throw std::bad_alloc();
+}
+} // namespace alloc_counter
+
+// every form of new, so nothrow and over aligned allocations count too
+void *operator new(std::size_t n) {
+  return alloc_counter::allocate_or_throw(n, 0);
+}
+void *operator new[](std::size_t n) {
+  return alloc_counter::allocate_or_throw(n, 0);
+}
+void *operator new(std::size_t n, std::align_val_t a) {
+  return alloc_counter::allocate_or_throw(n, (std::size_t)a);
+}
+void *operator new[](std::size_t n, std::align_val_t a) {
+  return alloc_counter::allocate_or_throw(n, (std::size_t)a);
+}
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept {
+  return alloc_counter::allocate(n, 0);
+}
+void *operator new[](std::size_t n, const std::nothrow_t &) noexcept {
+  return alloc_counter::allocate(n, 0);
+}
+void *operator new(std::size_t n, std::align_val_t a,
+                   const std::nothrow_t &) noexcept {
+  return alloc_counter::allocate(n, (std::size_t)a);
+}
+void *operator new[](std::size_t n, std::align_val_t a,
+                     const std::nothrow_t &) noexcept {
+  return alloc_counter::allocate(n, (std::size_t)a);
+}
+
+// malloc and aligned_alloc both go back through free
+void operator delete(void *p) noexcept { alloc_counter::release(p); }
+void operator delete[](void *p) noexcept { alloc_counter::release(p); }
+void operator delete(void *p, std::size_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete[](void *p, std::size_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete(void *p, std::align_val_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete[](void *p, std::align_val_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  alloc_counter::release(p);
+}
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  alloc_counter::release(p);
+}
+#endif
@@ -0,0 +1,93 @@
+#include "std_include.h"
+//
+#include <thread>
+
+#include "batch.h"
+
+// Lots of games in one BatchSim, random actions, as fast as it goes
+//
+//   ./tetr_batch.exe [games] [threads] [steps] [seed]
+//
+// threads of 0 is one per core. Each thread steps its own slice of the
+// games and a game that tops out starts over on a fresh stream from that
+// thread. Prints steps per second over every game
+
+int main(int argc, char **argv) {
+  long games = argc > 1 ? std::atol(argv[1]) : 4096;
+  int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+  long steps = argc > 3 ? std::atol(argv[3]) : 10'000;
+  uint64_t seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+
+  if (threads <= 0)
+    threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+  const float dt = tick_dt;
+  BatchSim batch((size_t)games, seed);
+  std::vector<InputAction> actions((size_t)games, InputAction::None);
+
+  // slices are whole multiples of 16 games, see step_range
+  size_t per_thread = ((size_t)games + (size_t)threads - 1) / (size_t)threads;
+  per_thread = (per_thread + 15) / 16 * 16;
+
+  // inputs and restarted games for each thread, the games themselves are
+  // split off of `seed` in BatchSim
+  std::vector<Rng> streams;
+  Rng root(~seed);
+  for (int t = 0; t < threads; t++)
+    streams.push_back(root.split());
+
+  std::vector<long> restarts((size_t)threads);
+  std::vector<long> pieces((size_t)threads);
+  std::vector<long> lines((size_t)threads);
+  auto worker = [&](int t) {
+    size_t begin = std::min((size_t)games, (size_t)t * per_thread);
+    size_t end = std::min((size_t)games, begin + per_thread);
+    Rng &rng = streams[(size_t)t];
+
+    for (long s = 0; s < steps; s++) {
+      // a press every few steps, like headless.cpp mashing
+      for (size_t i = begin; i < end; i++)
+        actions[i] = rng.next_int(4) == 0
+                         ? (InputAction)(1 + rng.next_int(5))
+                         : InputAction::None;
+      batch.step_range(actions.data(), dt, begin, end);
+      for (size_t i = begin; i < end; i++) {
+        if (!batch.game_over[i])
+          continue;
+        pieces[(size_t)t] += batch.pieces_placed[i];
+        lines[(size_t)t] += batch.lines_cleared[i];
+        restarts[(size_t)t]++;
+        batch.reset(i, rng.split());
+      }
+    }
+    for (size_t i = begin; i < end; i++) {
+      pieces[(size_t)t] += batch.pieces_placed[i];
+      lines[(size_t)t] += batch.lines_cleared[i];
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++)
+    pool.emplace_back(worker, t);
+  for (auto &t : pool)
+    t.join();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  long total_steps = games * steps;
+  std::cout << "games " << games << " on " << threads << " threads, "
+            << steps << " steps each in " << seconds << "s" << std::endl;
+  std::cout << "steps " << total_steps << " ("
+            << (double)total_steps / seconds << "/s, "
+            << (double)total_steps / seconds / threads << "/s per thread)"
+            << std::endl;
+  std::cout << "pieces "
+            << std::accumulate(pieces.begin(), pieces.end(), 0l) << " lines "
+            << std::accumulate(lines.begin(), lines.end(), 0l)
+            << " restarts "
+            << std::accumulate(restarts.begin(), restarts.end(), 0l)
+            << std::endl;
+  return 0;
+}
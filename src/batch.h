@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rng.h"
+#include "rules.h"
+
+// Thousands of games stepped together, for training and tuning
+//
+// Every field is one array with an entry per game (structure of arrays), so
+// each phase of a step is a loop over all of them. The ones that are the same
+// work for every game (timers, full row checks) have no branches and the
+// compiler vectorizes them. The ones that arent (moving and locking the
+// piece) go through the same rules.h code Sim does
+//
+// Board rows are the same but in blocks of `lanes` games: row y of every
+// game in a block sits side by side, one cache line of uint32_t, and the
+// block's rows follow each other. The full row check is then a vector
+// compare per row per block, and moving one game's piece around only
+// touches that block's few KB instead of a line per row across all of them
+//
+// A step is one InputAction per game, pressed for just that step: a shift,
+// a rotate, a soft drop or a hard drop. Otherwise it plays like Sim, gravity
+// every startTR, locking once nothing was pressed for lockDelay and the same
+// ground along the bottom
+struct BatchSim {
+  static constexpr size_t lanes = 16;
+
+  size_t size;
+
+  // what SpawnGround puts down, the same for every game
+  Board ground;
+
+  std::vector<Board::Row> rows;
+
+  std::vector<int32_t> type;
+  std::vector<int32_t> angle;
+  std::vector<int32_t> x;
+  std::vector<int32_t> y;
+  std::vector<uint8_t> has_piece;
+  std::vector<uint8_t> game_over;
+  std::vector<int32_t> next_type;
+  // Rng::state
+  std::vector<uint64_t> rng;
+
+  std::vector<float> fall_timer;
+  std::vector<float> since_last_input;
+  // rows touched by locks this step
+  std::vector<RowSet> dirty_rows;
+
+  std::vector<int32_t> lines_cleared;
+  std::vector<int32_t> pieces_placed;
+
+  // scratch for fall()
+  std::vector<uint8_t> fall_due;
+
+  // every game gets its own stream split off of `seed`, like selfplay
+  BatchSim(size_t n, uint64_t seed)
+      : size(n), rows((n + lanes - 1) / lanes * lanes * Board::rows_h),
+        type(n), angle(n), x(n), y(n), has_piece(n), game_over(n),
+        next_type(n), rng(n), fall_timer(n), since_last_input(n),
+        dirty_rows(n), lines_cleared(n), pieces_placed(n), fall_due(n) {
+    for (int i = 0; i < map_w; i += 4)
+      ground.lock(piece_shape(0, 0).mask, i, map_h - 1);
+    Rng root(seed);
+    for (size_t i = 0; i < n; i++)
+      reset(i, root.split());
+  }
+
+  void reset(size_t i, Rng r) {
+    for (int j = 0; j < Board::rows_h; j++)
+      row(i, j) = j < map_h ? Board::empty_row : Board::solid_row;
+    has_piece[i] = false;
+    game_over[i] = false;
+    next_type[i] = r.next_int(num_spawn_types);
+    rng[i] = r.state;
+    fall_timer[i] = startTR;
+    since_last_input[i] = 0.f;
+    dirty_rows[i] = 0;
+    lines_cleared[i] = 0;
+    pieces_placed[i] = 0;
+  }
+
+  [[nodiscard]] static size_t row_index(size_t i, int j) {
+    return ((i / lanes) * Board::rows_h + (size_t)j) * lanes + i % lanes;
+  }
+  [[nodiscard]] Board::Row &row(size_t i, int j) {
+    return rows[row_index(i, j)];
+  }
+  [[nodiscard]] const Board::Row &row(size_t i, int j) const {
+    return rows[row_index(i, j)];
+  }
+
+  [[nodiscard]] Piece piece(size_t i) const {
+    return Piece{type[i], angle[i], x[i], y[i]};
+  }
+
+  // the same test as Board::collides, against game i and the ground
+  [[nodiscard]] bool collides(size_t i, const PieceMask &mask, int px,
+                              int py) const {
+    int shift = px + Board::wall_w;
+    if (shift < 0 || shift > Board::row_bits - 4)
+      return true;
+    for (int r = 0; r < 4; r++) {
+      uint32_t pr = mask.rows[(size_t)r];
+      if (pr == 0)
+        continue;
+      int j = py + r;
+      if (j >= Board::rows_h)
+        return true;
+      // above the board is open apart from the walls
+      Board::Row r_j =
+          j < 0 ? Board::empty_row : row(i, j) | ground.rows[(size_t)j];
+      if (row_test(r_j, pr, shift))
+        return true;
+    }
+    return false;
+  }
+
+  // game i as a Board, for observations and checking against Sim
+  [[nodiscard]] Board board(size_t i) const {
+    Board out;
+    for (int j = 0; j < map_h; j++)
+      for (int c = 0; c < map_w; c++)
+        if (row_test(row(i, j), 1, c + Board::wall_w))
+          out.set(c, j);
+    return out;
+  }
+
+  // `actions` has one entry per game
+  void step(const InputAction *actions, float dt) {
+    step_range(actions, dt, 0, size);
+  }
+
+  // Only games [begin, end), threads can each take a range. Start them on a
+  // multiple of `lanes` so no two threads write the same cache line
+  void step_range(const InputAction *actions, float dt, size_t begin,
+                  size_t end) {
+    spawn(begin, end);
+    move(actions, dt, begin, end);
+    fall(dt, begin, end);
+    clear_lines(begin, end);
+  }
+
+  // step_range() starts with this, call it after a step too to have the
+  // next piece (and any top outs) in place before looking at the games
+  void spawn(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (has_piece[i] || game_over[i])
+        continue;
+      Rng r(rng[i]);
+      type[i] = next_type[i];
+      angle[i] = 0;
+      x[i] = spawn_x;
+      y[i] = spawn_y;
+      has_piece[i] = true;
+      next_type[i] = r.next_int(num_spawn_types);
+      rng[i] = r.state;
+      if (collides(i, piece_shape(type[i], 0).mask, spawn_x, spawn_y)) {
+        game_over[i] = true;
+        has_piece[i] = false;
+      }
+    }
+  }
+
+private:
+  void move(const InputAction *actions, float dt, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      InputAction action = actions[i];
+      if (!has_piece[i] || action == InputAction::None)
+        continue;
+      auto coll = [&](const PieceShape &shape, int px, int py) {
+        return collides(i, shape.mask, px, py);
+      };
+      Piece p = piece(i);
+      switch (action) {
+      case InputAction::Left:
+        try_shift(p, -1, 0, coll);
+        break;
+      case InputAction::Right:
+        try_shift(p, 1, 0, coll);
+        break;
+      case InputAction::Down:
+        try_shift(p, 0, 1, coll);
+        break;
+      case InputAction::Rotate:
+        try_rotate(p, coll);
+        break;
+      case InputAction::Drop:
+        p.y += drop_distance(p, coll);
+        break;
+      case InputAction::None:
+        break;
+      }
+      angle[i] = p.angle;
+      x[i] = p.x;
+      y[i] = p.y;
+      if (action == InputAction::Drop)
+        lock(i);
+    }
+
+    // the same for every game, no branches
+    for (size_t i = begin; i < end; i++)
+      since_last_input[i] =
+          actions[i] == InputAction::None ? since_last_input[i] + dt : 0.f;
+  }
+
+  void fall(float dt, size_t begin, size_t end) {
+    // Sim only moves a piece on the step after its timer went negative
+    for (size_t i = begin; i < end; i++) {
+      bool due = fall_timer[i] < 0;
+      fall_timer[i] = due ? startTR : fall_timer[i] - dt;
+      fall_due[i] = due;
+    }
+    for (size_t i = begin; i < end; i++) {
+      if (!fall_due[i] || !has_piece[i])
+        continue;
+      if (!collides(i, piece_shape(type[i], angle[i]).mask, x[i], y[i] + 1))
+        y[i]++;
+      else if (since_last_input[i] > lockDelay)
+        lock(i);
+    }
+  }
+
+  void lock(size_t i) {
+    const PieceMask &mask = piece_shape(type[i], angle[i]).mask;
+    int shift = x[i] + Board::wall_w;
+    for (int r = 0; r < 4; r++) {
+      int j = y[i] + r;
+      if (j < 0 || j >= map_h || mask.rows[(size_t)r] == 0)
+        continue;
+      row_set(row(i, j), mask.rows[(size_t)r], shift);
+      dirty_rows[i] |= RowSet(1) << j;
+    }
+    has_piece[i] = false;
+    pieces_placed[i]++;
+  }
+
+  void clear_lines(size_t begin, size_t end) {
+    for (size_t block = begin / lanes; block * lanes < end; block++) {
+      size_t lo = std::max(begin, block * lanes);
+      size_t hi = std::min(end, (block + 1) * lanes);
+      // at 240 steps a second most blocks locked nothing
+      RowSet dirty = 0;
+      for (size_t i = lo; i < hi; i++)
+        dirty |= dirty_rows[i];
+      if (dirty == 0)
+        continue;
+
+      // every lane at once, one compare per row that anything locked into
+      std::array<RowSet, lanes> full{};
+      for (RowSet d = dirty; d; d &= d - 1) {
+        int j = __builtin_ctzll(d);
+        const Board::Row *r = &rows[row_index(block * lanes, j)];
+        for (size_t l = 0; l < lanes; l++)
+          full[l] |= (RowSet)(r[l] == Board::solid_row) << j;
+      }
+      for (size_t i = lo; i < hi; i++)
+        clear(i, full[i % lanes] & dirty_rows[i]);
+    }
+  }
+
+  void clear(size_t i, RowSet full) {
+    dirty_rows[i] = 0;
+    if (full == 0)
+      return;
+    lines_cleared[i] += __builtin_popcountll(full);
+    // Board::clear_rows a lane at a time
+    int write = 63 - __builtin_clzll(full);
+    for (int read = write; read >= 0; read--) {
+      if ((full >> read) & 1)
+        continue;
+      row(i, write--) = row(i, read);
+    }
+    for (; write >= 0; write--)
+      row(i, write) = Board::empty_row;
+  }
+};
@@ -0,0 +1,334 @@
+
+#include "game.h"
+//
+#include "rng.h"
+
+// Micro benchmarks for the hot paths, no window needed
+//
+//   make bench
+//
+// Prints a single json object to stdout so runs from before and after a
+// change can be diffed or graphed. The make target builds with
+// TETR_COUNT_ALLOCS so every entry also says how often it hit the heap
+
+namespace bench {
+
+struct Result {
+  std::string name;
+  std::string board;
+  long iterations;
+  double ns_per_op;
+  // -1 when not built with TETR_COUNT_ALLOCS
+  double allocs_per_op;
+  // board cells one op walks over, for comparing boards of different sizes
+  long cells = 0;
+};
+
+// results get added in here so the optimizer cant throw the work away
+volatile long sink = 0;
+void keep(long v) { sink = sink + v; }
+
+// doubles the iteration count until a run takes long enough to trust
+template <typename Fn>
+Result run(const std::string &name, const std::string &board, Fn &&fn) {
+  using clock = std::chrono::steady_clock;
+  const double min_ns = 2e8;
+
+  for (long iters = 1;; iters *= 2) {
+    long allocs = alloc_counter::count();
+    auto start = clock::now();
+    for (long i = 0; i < iters; i++)
+      fn();
+    double ns =
+        std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    allocs = alloc_counter::count() - allocs;
+
+    if (ns > min_ns || iters >= (1l << 32)) {
+      double allocs_per_op =
+          alloc_counter::enabled ? (double)allocs / (double)iters : -1.;
+      return Result{name, board, iters, ns / (double)iters, allocs_per_op};
+    }
+  }
+}
+
+// `height` rows of junk above the ground, each with one hole so nothing
+// clears by accident
+Board make_board(int height, Rng &rng) {
+  Board board;
+  for (int j = map_h - 2; j > map_h - 2 - height; j--) {
+    int hole = rng.next_int(map_w);
+    for (int i = 0; i < map_w; i++)
+      if (i != hole)
+        board.set(i, j);
+  }
+  return board;
+}
+
+// make_board for any size, `height` junk rows at the bottom
+template <int W, int H> BasicBoard<W, H> make_wide_board(int height, Rng &rng) {
+  BasicBoard<W, H> board;
+  for (int j = H - 1; j > H - 1 - height; j--) {
+    int hole = rng.next_int(W);
+    for (int i = 0; i < W; i++)
+      if (i != hole)
+        board.set(i, j);
+  }
+  return board;
+}
+
+// The row kernels on a W x H board. full_rows and clear_rows touch every
+// row so they get a per cell time, collides only ever looks at the rows
+// under the piece and should cost the same on every width
+template <int W, int H>
+void run_board_kernels(std::vector<Result> &results, Rng &rng) {
+  using B = BasicBoard<W, H>;
+  std::string name = std::to_string(W) + "x" + std::to_string(H);
+  const long cells = (long)W * H;
+
+  B junk = make_wide_board<W, H>(H / 2, rng);
+  Result r = run("full_rows", name, [&] {
+    keep((long)junk.full_rows());
+  });
+  r.cells = cells;
+  results.push_back(r);
+
+  // the bottom 4 rows full, like a long boi standing up just cleared
+  B full = junk;
+  for (int j = H - 4; j < H; j++)
+    for (int i = 0; i < W; i++)
+      full.set(i, j);
+  B scratch;
+  r = run("clear_rows", name, [&] {
+    scratch = full;
+    scratch.clear_rows(scratch.full_rows());
+    keep(scratch.tops[0]);
+  });
+  r.cells = cells;
+  results.push_back(r);
+
+  const PieceMask &mask = piece_shape(2, 0).mask;
+  int x = 0;
+  results.push_back(run("collides", name, [&] {
+    x = x + 1 < W - 3 ? x + 1 : 0;
+    keep(junk.collides(mask, x, H / 2 - 2));
+  }));
+}
+
+// what one frame of the board sends to the gpu
+struct FrameStats {
+  size_t quads;
+  size_t draw_calls;
+};
+
+void print(const std::vector<Result> &results, const FrameStats &frame,
+           const FrameStats &rebuild) {
+  // the texture draw for the locked cells isnt in the buffer, count it here
+  std::cout << "{\n  \"render\": {\"quads\": " << frame.quads
+            << ", \"draw_calls\": " << frame.draw_calls + 1
+            << ", \"rebuild_quads\": " << rebuild.quads
+            << ", \"rebuild_draw_calls\": " << rebuild.draw_calls << "},\n";
+  std::cout << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    std::cout << "    {\"name\": \"" << r.name << "\", \"board\": \""
+              << r.board << "\", \"iterations\": " << r.iterations
+              << ", \"ns_per_op\": " << std::fixed << std::setprecision(2)
+              << r.ns_per_op << ", \"allocs_per_op\": " << r.allocs_per_op;
+    if (r.cells > 0)
+      std::cout << ", \"ns_per_cell\": " << std::setprecision(4)
+                << r.ns_per_op / (double)r.cells << std::setprecision(2);
+    std::cout << "}" << (i + 1 < results.size() ? "," : "")
+              << "\n";
+  }
+  std::cout << "  ]\n}" << std::endl;
+}
+
+} // namespace bench
+
+int main(void) {
+  // same singletons main() makes, minus the window and input
+  auto &sophie = EntityHelper::createEntity();
+  sophie.addComponent<NextPieceHolder>();
+  sophie.addComponent<Grid>();
+
+  auto &falling = EntityHelper::createEntity();
+  falling.addComponent<Transform>(to_pos(spawn_x, spawn_y));
+  falling.addComponent<IsFalling>();
+  falling.addComponent<PieceType>(2);
+
+  SystemManager systems;
+  systems.register_update_system(std::make_unique<SpawnGround>());
+  systems.run(0.f);
+
+  OptEntity opt_ground = EQ().whereHasComponent<IsGround>().gen_first();
+  Entity &ground = opt_ground.asE();
+
+  Grid &gridC = sophie.get<Grid>();
+  Transform &transform = falling.get<Transform>();
+  PieceType &pt = falling.get<PieceType>();
+  const IsFalling &is_falling = falling.get<IsFalling>();
+
+  Rng rng(1);
+  std::vector<std::pair<std::string, Board>> boards = {
+      {"empty", bench::make_board(0, rng)},
+      {"low", bench::make_board(6, rng)},
+      {"half", bench::make_board(16, rng)},
+      {"tall", bench::make_board(28, rng)},
+  };
+
+  std::vector<bench::Result> results;
+
+  results.push_back(bench::run("get_pips", "none", [&] {
+    bench::keep((long)get_pips(transform.pos(), pt.shape()).size());
+  }));
+
+  results.push_back(bench::run("Overlaps", "none", [&] {
+    Overlaps overlaps(to_pos(0, map_h - 2), pt.shape());
+    bench::keep(overlaps(ground));
+  }));
+
+  // a whole query over every entity, the afterhours one and the inline one
+  results.push_back(bench::run("query_overlaps", "EQ", [&] {
+    bench::keep(EQ().whereHasComponent<IsGround>()
+                    .whereLambda(Overlaps(to_pos(0, map_h - 2), pt.shape()))
+                    .has_values());
+  }));
+  results.push_back(bench::run("query_overlaps", "IQ", [&] {
+    bench::keep(IQ().whereHasComponent<IsGround>()
+                    .whereOverlaps(to_pos(0, map_h - 2), pt.shape())
+                    .any());
+  }));
+
+  for (auto &[name, board] : boards) {
+    gridC.board = board;
+    gridC.version++;
+
+    results.push_back(bench::run("will_collide", name, [&] {
+      bench::keep(will_collide(transform.pos(), pt.shape()));
+    }));
+
+    // what HandleInput and RenderGhost do on a cache miss
+    results.push_back(bench::run("hard_drop", name, [&] {
+      Piece piece = as_piece(transform, pt);
+      bench::keep(find_landing_row(piece, gridC.board, &collision_index.cells,
+                                   piece_collides));
+    }));
+
+    // the row by row fallback for pieces tucked under an overhang
+    results.push_back(bench::run("drop_search", name, [&] {
+      Piece piece = as_piece(transform, pt);
+      bench::keep(drop_distance(piece, piece_collides));
+    }));
+
+    results.push_back(bench::run("ghost", name, [&] {
+      active_piece.piece = as_piece(transform, pt);
+      bench::keep((long)ghost_position(active_piece).y);
+    }));
+
+    // a whole bot decision, every placement of this piece and the next
+    for (int threads : {1, 0}) {
+      bot::Config config;
+      config.threads = threads;
+      bot::Planner planner(config);
+      results.push_back(bench::run(
+          threads == 1 ? "bot_decide" : "bot_decide_mt", name, [&] {
+            Piece piece = as_piece(transform, pt);
+            bot::Decision d = planner.decide(piece, 3, gridC.board,
+                                             collision_index.cells);
+            bench::keep(d.placement.x);
+          }));
+    }
+  }
+
+  // the half board with the bottom n rows filled in, as if a long boi had
+  // just locked standing up in the bottom four rows
+  ClearLine clear_line;
+  const RowSet locked_rows = RowSet(0b1111) << (map_h - 5);
+  for (int full = 0; full <= 4; full++) {
+    Board board = boards[2].second;
+    for (int j = map_h - 2; j > map_h - 2 - full; j--)
+      for (int i = 0; i < map_w; i++)
+        board.set(i, j);
+
+    results.push_back(bench::run(
+        "ClearLine", "half+" + std::to_string(full) + "_full", [&] {
+          gridC.board = board;
+          gridC.version++;
+          gridC.dirty_rows = locked_rows;
+          clear_line.for_each_with(sophie, gridC, 0.f);
+          bench::keep(gridC.totalCleared);
+        }));
+  }
+
+  // the common case, nothing locked this frame
+  results.push_back(bench::run("ClearLine", "idle", [&] {
+    clear_line.for_each_with(sophie, gridC, 0.f);
+    bench::keep(gridC.totalCleared);
+  }));
+
+  // see snapshot.h, forking is a copy and a step with no ecs involved
+  Snapshot snap(1);
+  results.push_back(bench::run("save_game", "none", [&] {
+    save_game(snap);
+    bench::keep(snap.next_type);
+  }));
+  results.push_back(bench::run("fork", "none", [&] {
+    Snapshot copy = snap;
+    copy.step(SimInputs{}, tick_dt);
+    bench::keep(copy.pieces_placed);
+  }));
+  // with no piece up restore doesnt make a view entity, only copies
+  snap.has_piece = false;
+  results.push_back(bench::run("restore_game", "none", [&] {
+    restore_game(snap);
+    bench::keep((long)gridC.version);
+  }));
+
+  // big board modes should cost the same per cell as the normal board
+  bench::run_board_kernels<map_w, map_h>(results, rng);
+  bench::run_board_kernels<64, 64>(results, rng);
+  bench::run_board_kernels<256, 64>(results, rng);
+
+  // a frame of the board pushed and flushed, minus the gpu. the locked
+  // cells live in RenderGrid's texture so a steady frame is only the pieces
+  // and grid_rebuild is what a frame costs right after a lock
+  RenderPiece render_piece;
+  RenderGhost render_ghost;
+  RenderPreview render_preview;
+  gridC.board = boards[2].second;
+  gridC.version++;
+  auto build_frame = [&] {
+    render_piece.for_each_with(falling, transform, pt, 0.f);
+    for (Entity &g : EQ().whereHasComponent<IsGround>().gen())
+      render_piece.for_each_with(g, g.get<Transform>(), g.get<PieceType>(),
+                                 0.f);
+    render_ghost.for_each_with(falling, is_falling, pt, 0.f);
+    render_preview.for_each_with(sophie, sophie.get<NextPieceHolder>(), 0.f);
+  };
+
+  RecordingBackend recorder;
+  build_frame();
+  render_buffer.flush(recorder);
+  bench::FrameStats frame{recorder.quads, recorder.draw_calls};
+
+  RenderBuffer grid_cells;
+  recorder = RecordingBackend{};
+  push_grid(gridC, grid_cells);
+  grid_cells.flush(recorder);
+  bench::FrameStats rebuild{recorder.quads, recorder.draw_calls};
+
+  results.push_back(bench::run("render_frame", "half", [&] {
+    build_frame();
+    render_buffer.flush(recorder);
+    bench::keep((long)recorder.draw_calls);
+  }));
+
+  results.push_back(bench::run("grid_rebuild", "half", [&] {
+    push_grid(gridC, grid_cells);
+    grid_cells.flush(recorder);
+    bench::keep((long)recorder.draw_calls);
+  }));
+
+  bench::print(results, frame, rebuild);
+  return 0;
+}
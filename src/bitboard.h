@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+constexpr int map_h = 33;
+constexpr int map_w = 12;
+
+// one bit per board row, bit y is row y
+using RowSet = uint64_t;
+
+// A piece shape as one 4 bit mask per row
+// bit i of a row is column i of the 4x4 box
+struct PieceMask {
+  std::array<uint8_t, 4> rows{};
+  // per column of the box, the lowest filled row or -1 if the column is empty
+  std::array<int8_t, 4> bottom{{-1, -1, -1, -1}};
+};
+
+// A board row too wide for one int, `Words` 64 bit words with bit i of the
+// row at bit i % 64 of word i / 64
+//
+// Only the whole row ops (== and |=) have hand written kernels, thats full
+// row detection and merge. With -mavx2 they go 4 words at a time, otherwise
+// SSE2 2 at a time, whatever is left is plain words. Collision and lock only
+// ever touch the one or two words under a piece so they stay scalar
+template <size_t Words> struct alignas(32) WideRow {
+  std::array<uint64_t, Words> w{};
+
+  constexpr WideRow operator~() const {
+    WideRow out;
+    for (size_t i = 0; i < Words; i++)
+      out.w[i] = ~w[i];
+    return out;
+  }
+  constexpr WideRow &operator&=(const WideRow &o) {
+    for (size_t i = 0; i < Words; i++)
+      w[i] &= o.w[i];
+    return *this;
+  }
+  constexpr friend WideRow operator&(WideRow a, const WideRow &b) {
+    return a &= b;
+  }
+  friend WideRow operator|(WideRow a, const WideRow &b) { return a |= b; }
+
+  WideRow &operator|=(const WideRow &o) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= Words; i += 4)
+      store256(i, _mm256_or_si256(load256(i), o.load256(i)));
+#endif
+#if defined(__SSE2__)
+    for (; i + 2 <= Words; i += 2)
+      store128(i, _mm_or_si128(load128(i), o.load128(i)));
+#endif
+    for (; i < Words; i++)
+      w[i] |= o.w[i];
+    return *this;
+  }
+
+  friend bool operator==(const WideRow &a, const WideRow &b) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= Words; i += 4) {
+      __m256i diff = _mm256_xor_si256(a.load256(i), b.load256(i));
+      if (!_mm256_testz_si256(diff, diff))
+        return false;
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 2 <= Words; i += 2) {
+      __m128i eq = _mm_cmpeq_epi8(a.load128(i), b.load128(i));
+      if (_mm_movemask_epi8(eq) != 0xffff)
+        return false;
+    }
+#endif
+    for (; i < Words; i++)
+      if (a.w[i] != b.w[i])
+        return false;
+    return true;
+  }
+  friend bool operator!=(const WideRow &a, const WideRow &b) {
+    return !(a == b);
+  }
+
+private:
+#if defined(__AVX2__)
+  [[nodiscard]] __m256i load256(size_t i) const {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&w[i]));
+  }
+  void store256(size_t i, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&w[i]), v);
+  }
+#endif
+#if defined(__SSE2__)
+  [[nodiscard]] __m128i load128(size_t i) const {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(&w[i]));
+  }
+  void store128(size_t i, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&w[i]), v);
+  }
+#endif
+};
+
+// the smallest row that fits `Bits` bits
+template <int Bits>
+using RowFor =
+    std::conditional_t<Bits <= 32, uint32_t,
+                       std::conditional_t<Bits <= 64, uint64_t,
+                                          WideRow<(size_t)(Bits + 63) / 64>>>;
+
+// The row kernels, one overload for plain ints and one for WideRow.
+// `bits` is one row of a PieceMask and `shift` where its bit 0 goes
+
+template <std::unsigned_integral R> constexpr int row_width(const R &) {
+  return (int)sizeof(R) * 8;
+}
+template <size_t N> constexpr int row_width(const WideRow<N> &) {
+  return (int)N * 64;
+}
+
+// `n` set bits starting at `lo`
+template <std::unsigned_integral R> constexpr R row_range(int lo, int n) {
+  R out = 0;
+  for (int i = lo; i < lo + n; i++)
+    out |= R(1) << i;
+  return out;
+}
+template <typename R>
+  requires(!std::unsigned_integral<R>)
+constexpr R row_range(int lo, int n) {
+  R out;
+  for (int i = lo; i < lo + n; i++)
+    out.w[(size_t)i / 64] |= uint64_t(1) << (i % 64);
+  return out;
+}
+
+template <std::unsigned_integral R>
+bool row_test(const R &row, uint32_t bits, int shift) {
+  return row & (R(bits) << shift);
+}
+template <std::unsigned_integral R>
+void row_set(R &row, uint32_t bits, int shift) {
+  row |= R(bits) << shift;
+}
+template <std::unsigned_integral R> void row_unset(R &row, int bit) {
+  row &= ~(R(1) << bit);
+}
+
+// a piece row is 4 bits so it spills into at most one more word
+template <size_t N>
+bool row_test(const WideRow<N> &row, uint32_t bits, int shift) {
+  size_t word = (size_t)shift / 64;
+  int off = shift % 64;
+  uint64_t hit = row.w[word] & (uint64_t(bits) << off);
+  if (off > 60)
+    hit |= row.w[word + 1] & (uint64_t(bits) >> (64 - off));
+  return hit != 0;
+}
+template <size_t N> void row_set(WideRow<N> &row, uint32_t bits, int shift) {
+  size_t word = (size_t)shift / 64;
+  int off = shift % 64;
+  row.w[word] |= uint64_t(bits) << off;
+  if (off > 60)
+    row.w[word + 1] |= uint64_t(bits) >> (64 - off);
+}
+template <size_t N> void row_unset(WideRow<N> &row, int bit) {
+  row.w[(size_t)bit / 64] &= ~(uint64_t(1) << (bit % 64));
+}
+
+// calls fn(bit) for every set bit, lowest first
+template <std::unsigned_integral R, typename Fn>
+void for_each_bit(R row, Fn &&fn) {
+  for (; row; row &= row - 1)
+    fn(__builtin_ctzll(row));
+}
+template <size_t N, typename Fn>
+void for_each_bit(const WideRow<N> &row, Fn &&fn) {
+  for (size_t i = 0; i < N; i++)
+    for (uint64_t word = row.w[i]; word; word &= word - 1)
+      fn((int)i * 64 + __builtin_ctzll(word));
+}
+
+// The board is one row of bits per board row, column x lives at bit
+// (x + wall_w)
+//
+// Every bit outside of the playfield is set (the walls) and there are
+// floor_h solid rows under the board, so bounds checks are just part of the
+// AND instead of something we have to do per cell
+//
+// W and H are the playfield, rows are a uint32_t or uint64_t when they fit
+// and a WideRow past that, so a 64 or 256 wide board uses the same code as
+// the normal one
+template <int W, int H> struct BasicBoard {
+  static constexpr int width = W;
+  static constexpr int height = H;
+
+  // a 4 wide piece can hang at most 3 columns past either wall
+  static constexpr int wall_w = 3;
+  static constexpr int floor_h = 4;
+  static constexpr int rows_h = H + floor_h;
+
+  using Row = RowFor<W + (2 * wall_w)>;
+
+  static constexpr Row solid_row = ~Row{};
+  static constexpr Row cells_row = row_range<Row>(wall_w, W);
+  static constexpr Row empty_row = solid_row & ~cells_row;
+  static constexpr int row_bits = row_width(Row{});
+
+  static constexpr RowSet all_rows =
+      H == 64 ? ~RowSet(0) : (RowSet(1) << H) - 1;
+
+  static_assert(H <= 64, "board rows dont fit in a RowSet");
+
+  std::array<Row, rows_h> rows;
+  // per column, the row of the highest filled cell (H when empty)
+  std::array<int8_t, W> tops;
+
+  BasicBoard() { clear(); }
+
+  void clear() {
+    for (int j = 0; j < rows_h; j++)
+      rows[(size_t)j] = j < H ? empty_row : solid_row;
+    tops.fill((int8_t)H);
+  }
+
+  [[nodiscard]] bool is_set(int x, int y) const {
+    return row_test(rows[(size_t)y], 1, x + wall_w);
+  }
+
+  void set(int x, int y) {
+    row_set(rows[(size_t)y], 1, x + wall_w);
+    raise_top(x, y);
+  }
+
+  void unset(int x, int y) {
+    row_unset(rows[(size_t)y], x + wall_w);
+    if (tops[(size_t)x] != y)
+      return;
+    // that was the top of the column, look below for the next one
+    tops[(size_t)x] = (int8_t)H;
+    for (int k = y + 1; k < H; k++) {
+      if (is_set(x, k)) {
+        tops[(size_t)x] = (int8_t)k;
+        break;
+      }
+    }
+  }
+
+  // anything above the board is open so pieces can poke out the top
+  [[nodiscard]] const Row &row_at(int y) const {
+    if (y < 0)
+      return empty_row;
+    if (y >= rows_h)
+      return solid_row;
+    return rows[(size_t)y];
+  }
+
+  [[nodiscard]] bool collides(const PieceMask &piece, int x, int y) const {
+    int shift = x + wall_w;
+    if (shift < 0 || shift > row_bits - 4)
+      return true;
+    for (int r = 0; r < 4; r++) {
+      uint32_t pr = piece.rows[(size_t)r];
+      if (pr == 0)
+        continue;
+      if (row_test(row_at(y + r), pr, shift))
+        return true;
+    }
+    return false;
+  }
+
+  // returns the rows that got touched, only those can have become full
+  RowSet lock(const PieceMask &piece, int x, int y) {
+    RowSet touched = 0;
+    int shift = x + wall_w;
+    if (shift < 0 || shift > row_bits - 4)
+      return touched;
+    for (int r = 0; r < 4; r++) {
+      int yy = y + r;
+      if (yy < 0 || yy >= H || piece.rows[(size_t)r] == 0)
+        continue;
+      // anything past the playfield lands on wall bits that are already set
+      row_set(rows[(size_t)yy], piece.rows[(size_t)r], shift);
+      touched |= RowSet(1) << yy;
+      for (int c = 0; c < 4; c++) {
+        int xx = x + c;
+        if (((piece.rows[(size_t)r] >> c) & 1) && xx >= 0 && xx < W)
+          raise_top(xx, yy);
+      }
+    }
+    return touched;
+  }
+
+  // ORs in every cell of `other`, to collide against both in one go
+  void merge(const BasicBoard &other) {
+    for (size_t j = 0; j < rows.size(); j++)
+      rows[j] |= other.rows[j];
+    for (size_t x = 0; x < tops.size(); x++)
+      tops[x] = std::min(tops[x], other.tops[x]);
+  }
+
+  [[nodiscard]] bool is_full(int y) const {
+    return rows[(size_t)y] == solid_row;
+  }
+
+  [[nodiscard]] RowSet full_rows(RowSet candidates = all_rows) const {
+    RowSet full = 0;
+    for (RowSet c = candidates & all_rows; c; c &= c - 1) {
+      int y = __builtin_ctzll(c);
+      if (is_full(y))
+        full |= RowSet(1) << y;
+    }
+    return full;
+  }
+
+  // Removes every row in `cleared` in one pass from the bottom up, the rows
+  // that stay keep their order and slide down over the gaps
+  void clear_rows(RowSet cleared) {
+    cleared &= all_rows;
+    if (cleared == 0)
+      return;
+
+    // nothing below the lowest cleared row moves
+    int write = 63 - __builtin_clzll(cleared);
+    for (int read = write; read >= 0; read--) {
+      if ((cleared >> read) & 1)
+        continue;
+      rows[(size_t)write--] = rows[(size_t)read];
+    }
+    for (; write >= 0; write--)
+      rows[(size_t)write] = empty_row;
+
+    recompute_tops();
+  }
+
+  // The row a piece at (x, y) falls to, straight from the column heights
+  //
+  // -1 if some of the piece is already at or below the surface (tucked under
+  // an overhang), then only a real search will do. `also` is an optional
+  // second board that gets collided against too
+  [[nodiscard]] int landing_row(const PieceMask &piece, int x, int y,
+                                const BasicBoard *also = nullptr) const {
+    int land = rows_h;
+    for (int c = 0; c < 4; c++) {
+      int bottom = piece.bottom[(size_t)c];
+      if (bottom < 0)
+        continue;
+      int xx = x + c;
+      if (xx < 0 || xx >= W)
+        return -1;
+      int top = tops[(size_t)xx];
+      if (also && also->tops[(size_t)xx] < top)
+        top = also->tops[(size_t)xx];
+      if (y + bottom >= top)
+        return -1;
+      if (top - 1 - bottom < land)
+        land = top - 1 - bottom;
+    }
+    return land;
+  }
+
+private:
+  // walks down until every column has been seen
+  void recompute_tops() {
+    tops.fill((int8_t)H);
+    Row seen{};
+    for (int y = 0; y < H && (seen & cells_row) != cells_row; y++) {
+      for_each_bit(rows[(size_t)y] & cells_row & ~seen,
+                   [&](int bit) { tops[(size_t)(bit - wall_w)] = (int8_t)y; });
+      seen |= rows[(size_t)y];
+    }
+  }
+
+  void raise_top(int x, int y) {
+    if (y < tops[(size_t)x])
+      tops[(size_t)x] = (int8_t)y;
+  }
+};
+
+// the one the game is played on
+struct Board : BasicBoard<map_w, map_h> {};
@@ -0,0 +1,162 @@
+
+#include "std_include.h"
+//
+#include "rng.h"
+#include "rules.h"
+
+// Fuzzes BasicBoard against a plain bool grid
+//
+//   ./tetr_board_check.exe [seed]
+//
+// Random sets, unsets, full rows, piece locks and line clears go into both,
+// and after every one the rows, column tops and collisions have to agree.
+// The widths cover every row kernel: one word, a word with the walls
+// spilling past 64 bits, exactly 64, and WideRows well past it. make
+// board_check runs it once plain (SSE2 on x86-64) and once with -mavx2
+// since bitboard.h picks its kernels at compile time
+
+template <int W, int H> struct Model {
+  std::array<std::array<bool, W>, H> cells{};
+
+  [[nodiscard]] bool collides(const PieceMask &mask, int x, int y) const {
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        if (!((mask.rows[(size_t)r] >> c) & 1))
+          continue;
+        int xx = x + c;
+        int yy = y + r;
+        // walls and floor, anything above the board is open
+        if (xx < 0 || xx >= W || yy >= H)
+          return true;
+        if (yy >= 0 && cells[(size_t)yy][(size_t)xx])
+          return true;
+      }
+    }
+    return false;
+  }
+
+  void lock(const PieceMask &mask, int x, int y) {
+    for (int r = 0; r < 4; r++)
+      for (int c = 0; c < 4; c++)
+        if (((mask.rows[(size_t)r] >> c) & 1) && y + r >= 0)
+          cells[(size_t)(y + r)][(size_t)(x + c)] = true;
+  }
+
+  [[nodiscard]] RowSet full_rows() const {
+    RowSet full = 0;
+    for (int y = 0; y < H; y++)
+      if (std::all_of(cells[(size_t)y].begin(), cells[(size_t)y].end(),
+                      [](bool b) { return b; }))
+        full |= RowSet(1) << y;
+    return full;
+  }
+
+  void clear_rows(RowSet cleared) {
+    int write = H - 1;
+    for (int read = H - 1; read >= 0; read--)
+      if (!((cleared >> read) & 1))
+        cells[(size_t)write--] = cells[(size_t)read];
+    for (; write >= 0; write--)
+      cells[(size_t)write].fill(false);
+  }
+
+  [[nodiscard]] int top(int x) const {
+    for (int y = 0; y < H; y++)
+      if (cells[(size_t)y][(size_t)x])
+        return y;
+    return H;
+  }
+};
+
+// how many times the board and the model disagreed
+template <int W, int H> long check(uint64_t seed, int ops) {
+  using B = BasicBoard<W, H>;
+  B board;
+  Model<W, H> model;
+  Rng rng(seed);
+  long errors = 0;
+
+  auto same = [&](const B &b) {
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+        errors += b.is_set(x, y) != model.cells[(size_t)y][(size_t)x];
+  };
+
+  for (int i = 0; i < ops; i++) {
+    int op = rng.next_int(10);
+    int x = rng.next_int(W);
+    int y = rng.next_int(H);
+    if (op < 5) {
+      board.set(x, y);
+      model.cells[(size_t)y][(size_t)x] = true;
+    } else if (op < 7) {
+      board.unset(x, y);
+      model.cells[(size_t)y][(size_t)x] = false;
+    } else if (op == 7) {
+      for (int c = 0; c < W; c++)
+        board.set(c, y);
+      model.cells[(size_t)y].fill(true);
+    } else if (op == 8) {
+      // anywhere the piece box can be, walls and above the top included
+      const PieceMask &mask =
+          piece_shape(rng.next_int(num_piece_types), rng.next_int(num_angles))
+              .mask;
+      int px = rng.next_int(W + 2 * B::wall_w) - B::wall_w;
+      int py = rng.next_int(H + 4) - 4;
+      bool hit = model.collides(mask, px, py);
+      errors += hit != board.collides(mask, px, py);
+      if (!hit) {
+        board.lock(mask, px, py);
+        model.lock(mask, px, py);
+      }
+    } else {
+      RowSet full = model.full_rows();
+      errors += board.full_rows() != full;
+      board.clear_rows(full);
+      model.clear_rows(full);
+    }
+
+    for (int c = 0; c < W; c++)
+      errors += board.tops[(size_t)c] != model.top(c);
+    same(board);
+  }
+
+  B merged;
+  merged.merge(board);
+  same(merged);
+  return errors;
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1;
+  const int ops = 20000;
+
+  struct Size {
+    const char *name;
+    long errors;
+  };
+  Rng root(seed);
+  std::array<Size, 6> sizes = {{
+      {"10x20", check<map_w, map_h>(root.next(), ops)},
+      {"12x33", check<12, 33>(root.next(), ops)},
+      {"58x20", check<58, 20>(root.next(), ops)},
+      {"64x33", check<64, 33>(root.next(), ops)},
+      {"100x64", check<100, 64>(root.next(), ops)},
+      {"256x64", check<256, 64>(root.next(), ops)},
+  }};
+
+#if defined(__AVX2__)
+  const char *kernels = "avx2";
+#elif defined(__SSE2__)
+  const char *kernels = "sse2";
+#else
+  const char *kernels = "scalar";
+#endif
+  long total = 0;
+  for (const Size &s : sizes) {
+    std::cout << kernels << " " << s.name << ": " << s.errors
+              << " mismatches" << std::endl;
+    total += s.errors;
+  }
+  return total == 0 ? 0 : 1;
+}
@@ -0,0 +1,500 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "rules.h"
+
+// A bot that picks where each piece should go and then steers it there with
+// the same InputActions a player would press
+//
+// Every spot the piece can reach with left, right, rotate and soft drop
+// (kicks and tucks included) is found with a flood fill over
+// (angle, x, y). Each one gets locked and scored, the best few boards then
+// try every spot for the next piece and the best pair decides the move
+//
+// Boards here are `board`, the cells that can clear, plus `ground`, things
+// that can be stood on but never clear (what SpawnGround puts down)
+
+namespace bot {
+
+// what a board is worth, positive is good
+struct Weights {
+  float height = -0.51f;
+  float lines = 0.76f;
+  float holes = -0.36f;
+  float bumpiness = -0.18f;
+};
+
+// set the fields you want on a default one, a designated initializer that
+// leaves some out trips -Wmissing-field-initializers in the makefile flags
+struct Config {
+  Weights weights;
+  // how many boards from the current piece get tried with the next one
+  int beam_width = 8;
+  // threads used for the next piece, 0 is one per core
+  int threads = 0;
+};
+
+struct Placement {
+  int angle = 0;
+  int x = 0;
+  int y = 0;
+};
+
+inline Board merged(const Board &board, const Board &ground) {
+  Board both = board;
+  both.merge(ground);
+  return both;
+}
+
+inline float score(const Board &board, const Board &ground, int lines,
+                   const Weights &w) {
+  int height = 0;
+  int bumpiness = 0;
+  int prev = 0;
+  for (int x = 0; x < map_w; x++) {
+    int h = map_h - std::min(board.tops[(size_t)x], ground.tops[(size_t)x]);
+    height += h;
+    if (x > 0)
+      bumpiness += std::abs(h - prev);
+    prev = h;
+  }
+
+  // a hole is any empty cell with something above it in the same column
+  int holes = 0;
+  Board::Row covered = 0;
+  for (int y = 0; y < map_h; y++) {
+    Board::Row row =
+        (board.rows[(size_t)y] | ground.rows[(size_t)y]) & Board::cells_row;
+    holes += __builtin_popcount(covered & ~row);
+    covered |= row;
+  }
+
+  return w.height * (float)height + w.lines * (float)lines +
+         w.holes * (float)holes + w.bumpiness * (float)bumpiness;
+}
+
+// The flood fill, reused between searches so it never allocates
+struct Search {
+  enum Move : uint8_t { Start, Left, Right, Down, Rotate };
+
+  // pieces live in a 4x4 box
+  static constexpr int box_h = 4;
+  // y can go a little above the board when a kick lifts the piece
+  static constexpr int y_pad = 4;
+  static constexpr int num_y = Board::rows_h + y_pad;
+  static constexpr int num_x = map_w + Board::wall_w;
+  static constexpr int max_nodes = num_angles * num_y * num_x;
+  static_assert(num_x <= 32, "seen keeps one bit per x in a uint32_t");
+
+  struct Node {
+    Piece piece;
+    Move move;
+    int parent;
+  };
+
+  std::array<Node, max_nodes> nodes;
+  int size = 0;
+  int found = -1;
+  // one bit per x for every (angle, y) already queued
+  std::array<std::array<uint32_t, num_y>, num_angles> seen;
+
+  // every resting spot reachable from `start` goes into `out`, `both` is
+  // the board with the ground merged in
+  //
+  // if `target` is given the search stops once it gets there and `found`
+  // is left on its node, follow the parents back for the path
+  void run(const Piece &start, const Board &both, std::vector<Placement> *out,
+           const Placement *target = nullptr) {
+    auto coll = [&](const PieceShape &shape, int x, int y) {
+      return both.collides(shape.mask, x, y);
+    };
+
+    for (auto &angle : seen)
+      angle.fill(0);
+    size = 0;
+    found = -1;
+
+    // Above every column only the walls can be hit, so every row up there
+    // reaches the same spots as the lowest one. Soft drop skips straight to
+    // it instead of filling the empty part of the board row by row
+    int open_y =
+        *std::min_element(both.tops.begin(), both.tops.end()) - box_h;
+    if (coll(start.shape(), start.x, start.y))
+      return;
+    push(start, Start, -1);
+
+    for (int i = 0; i < size; i++) {
+      Piece piece = nodes[(size_t)i].piece;
+
+      if (target && piece.angle == target->angle && piece.x == target->x &&
+          piece.y == target->y) {
+        found = i;
+        return;
+      }
+
+      Piece next = piece;
+      if (try_shift(next, -1, 0, coll))
+        push(next, Left, i);
+      next = piece;
+      if (try_shift(next, 1, 0, coll))
+        push(next, Right, i);
+      next = piece;
+      if (try_shift(next, 0, 1, coll)) {
+        next.y = std::max(next.y, open_y);
+        push(next, Down, i);
+      }
+      else if (out)
+        out->push_back(Placement{piece.angle, piece.x, piece.y});
+      next = piece;
+      if (try_rotate(next, coll))
+        push(next, Rotate, i);
+    }
+  }
+
+private:
+  void push(const Piece &piece, Move move, int parent) {
+    int yi = piece.y + y_pad;
+    int xi = piece.x + Board::wall_w;
+    if (yi < 0 || yi >= num_y || xi < 0 || xi >= num_x)
+      return;
+    uint32_t &row = seen[(size_t)piece.angle][(size_t)yi];
+    if ((row >> xi) & 1)
+      return;
+    row |= uint32_t(1) << xi;
+    nodes[(size_t)size++] = Node{piece, move, parent};
+  }
+};
+
+inline Search &scratch_search() {
+  thread_local Search search;
+  return search;
+}
+
+// Threads that stay up between calls, so each placement only pays for a
+// wakeup instead of starting and joining every thread
+//
+// run() hands out fn(i) for every i in [0, n), the calling thread takes a
+// share too and it returns once all of them are done
+struct WorkerPool {
+  // `threads` counts the caller, 0 is one per core
+  explicit WorkerPool(int threads) {
+    if (threads <= 0)
+      threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 1; t < threads; t++)
+      workers.emplace_back([this, t] { work(t); });
+  }
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  [[nodiscard]] int num_threads() const { return (int)workers.size() + 1; }
+
+  template <typename Fn> void run(int n, Fn &&fn) {
+    if (workers.empty() || n <= 1) {
+      for (int i = 0; i < n; i++)
+        fn(i);
+      return;
+    }
+    // a plain function pointer and the lambda's address, so nothing
+    // allocates the way a std::function could
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &fn;
+      call = [](const void *f, int i) {
+        (*static_cast<std::remove_reference_t<Fn> *>(const_cast<void *>(f)))(
+            i);
+      };
+      count = n;
+      busy = (int)workers.size();
+      generation++;
+    }
+    wake.notify_all();
+    stripe(0, n, call, job);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+  }
+
+private:
+  using Call = void (*)(const void *, int);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  bool stopping = false;
+  unsigned generation = 0;
+  const void *job = nullptr;
+  Call call = nullptr;
+  int count = 0;
+  int busy = 0;
+
+  void stripe(int t, int n, Call c, const void *f) const {
+    for (int i = t; i < n; i += num_threads())
+      c(f, i);
+  }
+
+  void work(int t) {
+    unsigned seen = 0;
+    for (;;) {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+      Call c = call;
+      const void *f = job;
+      int n = count;
+      lock.unlock();
+
+      stripe(t, n, c, f);
+
+      lock.lock();
+      if (--busy == 0)
+        finished.notify_one();
+    }
+  }
+};
+
+struct Decision {
+  bool found = false;
+  Placement placement;
+  float score = 0.f;
+};
+
+// Picks where `piece` should go, looking one piece ahead at `next_type`
+struct Planner {
+  Config config;
+
+  struct Candidate {
+    Placement placement;
+    Board board;
+    int lines;
+    float score;
+  };
+  std::vector<Candidate> beam;
+  std::vector<float> best_next;
+  // started on the first decide() that wants more than one thread
+  std::unique_ptr<WorkerPool> pool;
+
+  explicit Planner(Config c = Config{}) : config(c) {}
+
+  // every placement of `piece`, locked and cleared, into `out`
+  void expand(const Piece &piece, const Board &board, const Board &ground,
+              int lines, std::vector<Candidate> &out) const {
+    thread_local std::vector<Placement> placements;
+    placements.clear();
+    scratch_search().run(piece, merged(board, ground), &placements);
+
+    for (const Placement &p : placements) {
+      Candidate c{p, board, lines, 0.f};
+      const PieceShape &shape = piece_shape(piece.type, p.angle);
+      c.lines += clear_full_rows(c.board, c.board.lock(shape.mask, p.x, p.y))
+                     .count;
+      c.score = score(c.board, ground, c.lines, config.weights);
+      out.push_back(c);
+    }
+  }
+
+  Decision decide(const Piece &piece, int next_type, const Board &board,
+                  const Board &ground) {
+    beam.clear();
+    expand(piece, board, ground, 0, beam);
+    if (beam.empty())
+      return Decision{};
+
+    size_t width = std::min(beam.size(), (size_t)config.beam_width);
+    std::partial_sort(beam.begin(), beam.begin() + (long)width, beam.end(),
+                      [](const Candidate &a, const Candidate &b) {
+                        return a.score > b.score;
+                      });
+    beam.resize(width);
+
+    // each board in the beam is scored by the best spot for the next piece
+    best_next.assign(width, -std::numeric_limits<float>::infinity());
+    Piece next{next_type, 0, spawn_x, spawn_y};
+    if (!pool && config.threads != 1)
+      pool = std::make_unique<WorkerPool>(config.threads);
+    auto score_next = [&](int i) {
+      thread_local std::vector<Candidate> children;
+      children.clear();
+      const Candidate &c = beam[(size_t)i];
+      expand(next, c.board, ground, c.lines, children);
+      for (const Candidate &child : children)
+        best_next[(size_t)i] = std::max(best_next[(size_t)i], child.score);
+    };
+    if (pool)
+      pool->run((int)width, score_next);
+    else
+      for (int i = 0; i < (int)width; i++)
+        score_next(i);
+
+    Decision best;
+    for (size_t i = 0; i < width; i++) {
+      // a board the next piece cant spawn on is only taken if its all we got
+      float s = best_next[i] == -std::numeric_limits<float>::infinity()
+                    ? beam[i].score - 1e6f
+                    : best_next[i];
+      if (!best.found || s > best.score)
+        best = Decision{true, beam[i].placement, s};
+    }
+    return best;
+  }
+};
+
+// Turns decisions into button presses
+//
+// The path to the target is searched once and then followed for as long as
+// the piece is somewhere on it. Gravity can put it elsewhere, then we
+// search again from wherever it ended up
+//
+// Input is handled on the press (see controls.h), so a button held over two
+// ticks is one move and then a wait for das. Every press gets let go of on
+// the tick after so each one counts
+struct Player {
+  // where the piece is and the button that takes it to the next spot
+  struct Step {
+    Piece piece;
+    Search::Move move;
+  };
+
+  Planner planner;
+  bool has_target = false;
+  Placement target;
+  std::vector<Step> path;
+  size_t on_step = 0;
+  // the piece we planned for, anything that bumps it means a new piece
+  unsigned planned_for = ~0u;
+
+  // Some paths only work if nothing falls while you take them (kicks that
+  // lift the piece, long slides under a roof) and gravity keeps knocking us
+  // back to the start. After this many searches for one piece just drop it
+  static constexpr int max_searches = 32;
+  int searches = 0;
+
+  InputAction pressed = InputAction::None;
+
+  explicit Player(Config config = Config{}) : planner(config) {
+    path.reserve(64);
+  }
+
+  InputAction act(const Piece &piece, int next_type, const Board &board,
+                  const Board &ground, unsigned version) {
+    if (pressed != InputAction::None) {
+      pressed = InputAction::None;
+      return InputAction::None;
+    }
+    pressed = choose(piece, next_type, board, ground, version);
+    return pressed;
+  }
+
+private:
+  InputAction choose(const Piece &piece, int next_type, const Board &board,
+                     const Board &ground, unsigned version) {
+    if (version != planned_for) {
+      has_target = false;
+      planned_for = version;
+      searches = 0;
+    }
+    if (!has_target) {
+      Decision d = planner.decide(piece, next_type, board, ground);
+      has_target = d.found;
+      target = d.placement;
+      path.clear();
+      if (!has_target)
+        return InputAction::Drop;
+    }
+
+    Board both = merged(board, ground);
+    auto coll = [&](const PieceShape &shape, int x, int y) {
+      return both.collides(shape.mask, x, y);
+    };
+    if (piece.angle == target.angle && piece.x == target.x &&
+        find_landing_row(piece, both, nullptr, coll) == target.y)
+      return InputAction::Drop;
+
+    // only forward, going back to an earlier step would loop forever
+    for (size_t i = on_step; i < path.size(); i++) {
+      if (same_spot(path[i].piece, piece)) {
+        on_step = i;
+        return to_action(path[i].move);
+      }
+    }
+
+    if (++searches > max_searches)
+      return InputAction::Drop;
+    if (!find_path(piece, both)) {
+      // fell past it or got boxed out, plan again next frame
+      has_target = false;
+      return InputAction::None;
+    }
+    return to_action(path.front().move);
+  }
+
+  static bool same_spot(const Piece &a, const Piece &b) {
+    return a.angle == b.angle && a.x == b.x && a.y == b.y;
+  }
+
+  static InputAction to_action(Search::Move move) {
+    switch (move) {
+    case Search::Left:
+      return InputAction::Left;
+    case Search::Right:
+      return InputAction::Right;
+    case Search::Down:
+      return InputAction::Down;
+    case Search::Rotate:
+      return InputAction::Rotate;
+    case Search::Start:
+      break;
+    }
+    return InputAction::None;
+  }
+
+  bool find_path(const Piece &piece, const Board &both) {
+    Search &search = scratch_search();
+    search.run(piece, both, nullptr, &target);
+    path.clear();
+    if (search.found < 0)
+      return false;
+
+    // walk back from the target, each node knows the move that got to it
+    Search::Move move = Search::Start;
+    for (int n = search.found; n >= 0; n = search.nodes[(size_t)n].parent) {
+      path.push_back(Step{search.nodes[(size_t)n].piece, move});
+      move = search.nodes[(size_t)n].move;
+    }
+    std::reverse(path.begin(), path.end());
+
+    // a Down edge can skip the open rows above the stack but a press only
+    // moves one row, so put every row in between on the path too
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+      Piece below = path[i].piece;
+      below.y++;
+      if (path[i].move == Search::Down && path[i + 1].piece.y > below.y)
+        path.insert(path.begin() + (long)i + 1, Step{below, Search::Down});
+    }
+    on_step = 0;
+    return true;
+  }
+};
+
+} // namespace bot
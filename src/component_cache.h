@@ -0,0 +1,27 @@
+#pragma once
+
+// Lookups that would otherwise be an EQ walk over every entity
+//
+// A component's ctor runs on addComponent and its dtor on removeComponent or
+// at the latest when its entity gets cleaned up, so hanging the bookkeeping
+// off of those means these cant go stale and reading them is just a load
+
+// For components there is only ever one of (see enforce_singletons)
+// struct Grid : public BaseComponent, public Singleton<Grid>
+template <typename T> struct Singleton {
+  Singleton() { instance = this; }
+  // a copy, even a temporary, would take over get() and then null it out
+  // when it went away, so there is only ever the one made by addComponent
+  Singleton(const Singleton &) = delete;
+  Singleton &operator=(const Singleton &) = delete;
+  ~Singleton() {
+    if (instance == this)
+      instance = nullptr;
+  }
+
+  [[nodiscard]] static bool exists() { return instance != nullptr; }
+  [[nodiscard]] static T &get() { return static_cast<T &>(*instance); }
+
+private:
+  static inline Singleton *instance = nullptr;
+};
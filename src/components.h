@@ -4,37 +4,93 @@
 // so the includes are above in main.cpp
 
 struct Transform : public BaseComponent {
-  Transform(vec2 pos) : position(pos) {}
+  Transform(vec2 pos) : position(pos), previous(pos) {}
+  // a copy isnt in the index, only the original is
+  Transform(const Transform &other)
+      : position(other.position), previous(other.previous) {}
+  // assigning would copy the footprint and leave two owners of one entry
+  Transform &operator=(const Transform &) = delete;
 
-  virtual ~Transform() {}
+  virtual ~Transform() {
+    if (footprint)
+      collision_index.remove(*footprint, cell_x(), cell_y());
+  }
 
   [[nodiscard]] vec2 pos() const { return position; }
-  void update(vec2 v) { position = v; }
+
+  // Where to draw it, `alpha` of the way from where it was at the start of
+  // the last tick to where it is now
+  [[nodiscard]] vec2 interpolated(float alpha) const {
+    return previous + (position - previous) * alpha;
+  }
+  void start_tick() { previous = position; }
+
+  void update(vec2 v) {
+    if (footprint) {
+      collision_index.remove(*footprint, cell_x(), cell_y());
+      collision_index.add(*footprint, to_cell(v.x), to_cell(v.y));
+    }
+    position = v;
+  }
+
+  // Puts this entity in collision_index, which then follows every update()
+  // anything with HasCollision that isnt the falling piece needs this or
+  // nothing will hit it
+  void index_as(const PieceMask &mask) {
+    if (footprint)
+      collision_index.remove(*footprint, cell_x(), cell_y());
+    footprint = mask;
+    collision_index.add(*footprint, cell_x(), cell_y());
+  }
 
 private:
   vec2 position;
+  vec2 previous;
+  std::optional<PieceMask> footprint;
+
+  [[nodiscard]] int cell_x() const { return to_cell(position.x); }
+  [[nodiscard]] int cell_y() const { return to_cell(position.y); }
 };
 
 struct HasCollision : public BaseComponent {};
 struct IsGround : public BaseComponent {};
 struct IsLocked : public BaseComponent {};
-struct IsFalling : public BaseComponent {};
+
+// Marks the entity that draws active_piece, its Transform and PieceType get
+// copied over from it every tick by SyncFallingView. Moving this entity does
+// nothing, move active_piece
+struct IsFalling : public BaseComponent {
+  // the ActivePiece::serial this is showing
+  unsigned serial;
+  explicit IsFalling(unsigned s = 0) : serial(s) {}
+};
 
 struct PieceType : public BaseComponent {
-  PieceType(int t) : type(t), angle(0) {
-    shape = type_to_rotated_array(type, angle);
-  }
+  PieceType(int t) : type(t), angle(0) {}
   int type;
-  std::array<int, 16> shape;
   int angle;
+
+  [[nodiscard]] const PieceShape &shape() const {
+    return piece_shape(type, angle);
+  }
 };
 
-struct NextPieceHolder : public BaseComponent {
+struct NextPieceHolder : public BaseComponent,
+                         public Singleton<NextPieceHolder> {
+  // each game picks from its own, so the same seed deals the same pieces
+  Rng rng;
   int next_type;
-  NextPieceHolder() : next_type(rand() % 6) {}
+  explicit NextPieceHolder(uint64_t seed = 1)
+      : rng(seed), next_type(rng.next_int(num_spawn_types)) {}
 };
 
-struct Grid : public BaseComponent {
+struct Grid : public BaseComponent, public Singleton<Grid> {
   int totalCleared = 0;
-  std::array<std::array<int, map_h>, map_w> grid;
+  int pieces_placed = 0;
+  // bumped whenever the locked cells change
+  unsigned version = 0;
+  // rows touched by locks that ClearLine hasnt looked at yet
+  RowSet dirty_rows = 0;
+  LineClear last_clear;
+  Board board;
 };
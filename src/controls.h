@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+
+#include "rules.h"
+
+// Turning button presses into piece moves, shared by the systems and Sim
+//
+// The held buttons are polled once a frame and every change since the last
+// poll goes into an InputQueue, handled on that same tick, so reacting
+// doesnt wait on a cooldown. A tap that goes down and up between two polls
+// is never seen though. Holding left or right shifts once, waits `das` and
+// then repeats every `arr`. Holding down soft drops every `soft_drop`.
+// Rotate and drop are once per press
+
+struct SimInputs {
+  bool left = false;
+  bool right = false;
+  bool down = false;
+  bool rotate = false;
+  bool drop = false;
+
+  [[nodiscard]] bool any() const {
+    return left || right || down || rotate || drop;
+  }
+};
+
+inline void hold(SimInputs &in, InputAction action) {
+  in.left |= action == InputAction::Left;
+  in.right |= action == InputAction::Right;
+  in.down |= action == InputAction::Down;
+  in.rotate |= action == InputAction::Rotate;
+  in.drop |= action == InputAction::Drop;
+}
+
+// one button held, for anything handing step() InputActions
+inline SimInputs inputs_for(InputAction action) {
+  SimInputs in;
+  hold(in, action);
+  return in;
+}
+
+// all in seconds
+struct Handling {
+  // delayed auto shift, how long left or right has to be held to repeat
+  float das = 0.167f;
+  // auto repeat rate, 0 goes straight to the wall
+  float arr = 0.033f;
+  float soft_drop = 0.05f;
+};
+
+struct InputEvent {
+  InputAction action;
+  bool down;
+  // when the poll saw it, for latency. any clock, as long as its the same
+  double time;
+};
+
+struct InputQueue {
+  // a tick only sees a handful, past this they get dropped
+  std::array<InputEvent, 32> events;
+  size_t size = 0;
+
+  void push(const InputEvent &event) {
+    if (size < events.size())
+      events[size++] = event;
+  }
+  void clear() { size = 0; }
+
+  [[nodiscard]] const InputEvent *begin() const { return events.data(); }
+  [[nodiscard]] const InputEvent *end() const { return events.data() + size; }
+
+  // an event for every button that went down or up between `was` and `now`
+  void push_changes(const SimInputs &was, const SimInputs &now, double time) {
+    auto diff = [&](bool a, bool b, InputAction action) {
+      if (a != b)
+        push(InputEvent{action, b, time});
+    };
+    diff(was.left, now.left, InputAction::Left);
+    diff(was.right, now.right, InputAction::Right);
+    diff(was.down, now.down, InputAction::Down);
+    diff(was.rotate, now.rotate, InputAction::Rotate);
+    diff(was.drop, now.drop, InputAction::Drop);
+  }
+};
+
+// what the piece should do this tick, in this order
+struct TickActions {
+  bool rotate = false;
+  // negative is left
+  int shift = 0;
+  int soft_drops = 0;
+  bool drop = false;
+  // the earliest press behind any of the above, -1 if it was all repeats
+  double pressed_at = -1;
+
+  [[nodiscard]] bool any() const {
+    return rotate || shift != 0 || soft_drops > 0 || drop;
+  }
+};
+
+struct Controls {
+  Handling handling;
+  SimInputs held;
+
+  // the direction that got pressed last wins when both are held
+  int shift_dir = 0;
+  float das_timer = 0.f;
+  float arr_timer = 0.f;
+  float soft_timer = 0.f;
+
+  TickActions update(const InputQueue &queue, float dt) {
+    TickActions out;
+    auto pressed = [&](double time) {
+      if (out.pressed_at < 0 || time < out.pressed_at)
+        out.pressed_at = time;
+    };
+
+    for (const InputEvent &e : queue) {
+      switch (e.action) {
+      case InputAction::Left:
+      case InputAction::Right: {
+        int dir = e.action == InputAction::Left ? -1 : 1;
+        (dir < 0 ? held.left : held.right) = e.down;
+        if (e.down) {
+          shift_dir = dir;
+          out.shift += dir;
+          das_timer = handling.das;
+          arr_timer = 0.f;
+          pressed(e.time);
+        } else if (shift_dir == dir) {
+          // fall back to the other one if its still held
+          shift_dir = held.left ? -1 : held.right ? 1 : 0;
+          das_timer = handling.das;
+        }
+        break;
+      }
+      case InputAction::Down:
+        held.down = e.down;
+        if (e.down) {
+          out.soft_drops++;
+          soft_timer = handling.soft_drop;
+          pressed(e.time);
+        }
+        break;
+      case InputAction::Rotate:
+        held.rotate = e.down;
+        if (e.down) {
+          out.rotate = true;
+          pressed(e.time);
+        }
+        break;
+      case InputAction::Drop:
+        held.drop = e.down;
+        if (e.down) {
+          out.drop = true;
+          pressed(e.time);
+        }
+        break;
+      case InputAction::None:
+        break;
+      }
+    }
+
+    if (shift_dir != 0 && out.shift == 0) {
+      das_timer -= dt;
+      if (das_timer <= 0.f) {
+        if (handling.arr <= 0.f) {
+          out.shift = shift_dir * map_w;
+        } else {
+          for (arr_timer -= dt; arr_timer <= 0.f; arr_timer += handling.arr)
+            out.shift += shift_dir;
+        }
+      }
+    }
+
+    if (held.down && out.soft_drops == 0) {
+      for (soft_timer -= dt; soft_timer <= 0.f;
+           soft_timer += handling.soft_drop)
+        out.soft_drops++;
+    }
+    return out;
+  }
+};
+
+// Applies a tick's actions to `piece`, hard drop aside since what that
+// means is up to the caller. Returns whether the piece moved at all
+template <typename Collides>
+bool apply_actions(Piece &piece, const TickActions &actions,
+                   Collides &&collides) {
+  bool moved = false;
+  if (actions.rotate)
+    moved |= try_rotate(piece, collides);
+  int dir = actions.shift < 0 ? -1 : 1;
+  for (int i = 0; i < std::abs(actions.shift); i++) {
+    if (!try_shift(piece, dir, 0, collides))
+      break;
+    moved = true;
+  }
+  for (int i = 0; i < actions.soft_drops; i++) {
+    if (!try_shift(piece, 0, 1, collides))
+      break;
+    moved = true;
+  }
+  return moved;
+}
+
+// The poll that saw a press to the first presented frame that showed what
+// it did. Presses are stamped with the polling tick's time, not when the
+// key really went down, so up to a frame of polling delay isnt in here
+struct LatencyStats {
+  // a ring of the most recent samples in seconds
+  std::array<float, 256> samples{};
+  size_t count = 0;
+  // the press behind a move that hasnt been on screen yet
+  double pending = -1;
+
+  void moved(double pressed_at) {
+    if (pressed_at >= 0 && (pending < 0 || pressed_at < pending))
+      pending = pressed_at;
+  }
+
+  void presented(double now) {
+    if (pending < 0)
+      return;
+    samples[count++ % samples.size()] = (float)(now - pending);
+    pending = -1;
+  }
+
+  [[nodiscard]] size_t num_samples() const {
+    return std::min(count, samples.size());
+  }
+
+  [[nodiscard]] float mean() const {
+    size_t n = num_samples();
+    float sum = 0.f;
+    for (size_t i = 0; i < n; i++)
+      sum += samples[i];
+    return n ? sum / (float)n : 0.f;
+  }
+
+  [[nodiscard]] float max() const {
+    size_t n = num_samples();
+    return n ? *std::max_element(samples.begin(), samples.begin() + (long)n)
+             : 0.f;
+  }
+};
@@ -0,0 +1,124 @@
+#include "std_include.h"
+//
+#include "bot.h"
+#include "dataset.h"
+#include "sim.h"
+
+// Makes and reads lock datasets with no window
+//
+//   ./tetr_dataset.exe write <file> [games] [seed] [max_pieces]
+//   ./tetr_dataset.exe read <file>
+//
+// write has the bot play `games` games, each ending when it tops out or
+// reaches max_pieces. read walks every record front to back, then reads a
+// few million at random, and prints how fast both went
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+int cmd_write(const char *path, int games, uint64_t seed, int max_pieces) {
+  dataset::Writer writer;
+  if (!writer.open(path)) {
+    std::cerr << "couldnt open " << path << std::endl;
+    return 1;
+  }
+
+  const float dt = tick_dt;
+  bot::Config config;
+  config.threads = 1;
+  bot::Player player(config);
+  Rng root(seed);
+
+  auto start = clock_type::now();
+  for (int g = 0; g < games; g++) {
+    Sim sim(root.split());
+    writer.start_game();
+    while (!sim.game_over && sim.pieces_placed < max_pieces) {
+      InputAction action = InputAction::None;
+      if (sim.has_piece)
+        action = player.act(sim.piece, sim.next_type, sim.board, sim.ground,
+                            (unsigned)sim.pieces_placed);
+      // step() clears lines right after the lock, keep what it locked onto
+      Board before = sim.board;
+      int placed = sim.pieces_placed;
+      int lines = sim.lines_cleared;
+      sim.step(inputs_for(action), dt);
+      if (sim.pieces_placed != placed)
+        writer.add(before, sim.piece, sim.next_type,
+                   sim.lines_cleared - lines);
+    }
+  }
+  double seconds = seconds_since(start);
+  uint64_t records = writer.records;
+  if (!writer.close()) {
+    std::cerr << "couldnt finish " << path << std::endl;
+    return 1;
+  }
+  std::cout << "wrote " << records << " records from " << games
+            << " games in " << seconds << "s" << std::endl;
+  return 0;
+}
+
+int cmd_read(const char *path) {
+  dataset::Reader reader;
+  if (!reader.open(path)) {
+    std::cerr << "couldnt load " << path << std::endl;
+    return 1;
+  }
+  size_t n = reader.size();
+  std::cout << n << " records, " << reader.num_games() << " games"
+            << std::endl;
+  if (n == 0)
+    return 0;
+
+  auto start = clock_type::now();
+  std::array<long, 5> by_lines{};
+  long cells = 0;
+  for (const dataset::Record &r : reader) {
+    by_lines[std::min<size_t>(r.lines, 4)]++;
+    for (uint8_t byte : r.board)
+      cells += __builtin_popcount(byte);
+  }
+  double seconds = seconds_since(start);
+  std::cout << "walked them in " << seconds << "s ("
+            << (double)n / seconds << " records/s), "
+            << (double)cells / (double)n << " cells per board" << std::endl;
+  std::cout << "locks clearing 0-4 lines:";
+  for (long c : by_lines)
+    std::cout << " " << c;
+  std::cout << std::endl;
+
+  Rng rng(1);
+  const long samples = 4'000'000;
+  long lines = 0;
+  start = clock_type::now();
+  for (long i = 0; i < samples; i++)
+    lines += reader[rng.next() % n].lines;
+  seconds = seconds_since(start);
+  std::cout << samples << " random reads in " << seconds << "s ("
+            << (double)samples / seconds << "/s), "
+            << (double)lines / (double)samples << " lines per lock"
+            << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: tetr_dataset.exe write|read <file> ..." << std::endl;
+    return 1;
+  }
+  std::string_view cmd = argv[1];
+  const char *path = argv[2];
+
+  if (cmd == "write")
+    return cmd_write(path, argc > 3 ? std::atoi(argv[3]) : 100,
+                     argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1,
+                     argc > 5 ? std::atoi(argv[5]) : 10'000);
+  if (cmd == "read")
+    return cmd_read(path);
+  std::cerr << "unknown command " << cmd << std::endl;
+  return 1;
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rules.h"
+
+// Every piece lock as a training example, in one memory mapped file
+//
+// A record is the board before the lock (not the ground, thats the same
+// every game), the piece where it locked, the next piece and how many lines
+// the lock cleared, bit packed into 64 bytes. Records are fixed size and
+// follow the header back to back, so record i is at a known offset and
+// reading one is a pointer into the mapping with nothing to parse. The file
+// is only ever appended to
+//
+// File layout, little endian:
+//
+//   Header (64 bytes)
+//   Record * records
+//   u64 * games, the first record of each game (written by close())
+//
+// The header's record count is kept up to date as records go in, so a
+// session that crashes still leaves every record readable, just no index
+//
+// Writer::add is a 64 byte copy into the mapping, the file grows a big chunk
+// at a time so remapping almost never happens during play. POSIX only
+
+namespace dataset {
+
+constexpr char magic[4] = {'T', 'R', 'D', 'S'};
+constexpr uint16_t version = 1;
+
+// bit (y * map_w + x) of `board` is cell (x, y)
+constexpr size_t board_bytes = (map_w * map_h + 7) / 8;
+
+struct Record {
+  std::array<uint8_t, board_bytes> board;
+  // the placement
+  uint8_t type;
+  uint8_t angle;
+  int8_t x;
+  int8_t y;
+  uint8_t next_type;
+  // the outcome, lines this lock cleared
+  uint8_t lines;
+  // which game in the file and how many pieces it had placed before this
+  uint32_t game;
+  uint32_t piece;
+
+  [[nodiscard]] bool is_set(int cx, int cy) const {
+    size_t bit = (size_t)(cy * map_w + cx);
+    return (board[bit / 8] >> (bit % 8)) & 1;
+  }
+
+  [[nodiscard]] Piece placement() const {
+    return Piece{type, angle, x, y};
+  }
+
+  [[nodiscard]] Board to_board() const {
+    Board out;
+    for (int cy = 0; cy < map_h; cy++)
+      for (int cx = 0; cx < map_w; cx++)
+        if (is_set(cx, cy))
+          out.set(cx, cy);
+    return out;
+  }
+};
+static_assert(sizeof(Record) == 64, "records should be a cache line");
+static_assert(std::is_trivially_copyable_v<Record>,
+              "records are read straight out of the mapping");
+
+struct Header {
+  char magic[4];
+  uint16_t version;
+  uint16_t record_size;
+  uint16_t width;
+  uint16_t height;
+  uint32_t reserved;
+  uint64_t records;
+  // byte offset of the game index, 0 when there isnt one
+  uint64_t index_offset;
+  uint64_t games;
+  uint8_t padding[24];
+};
+static_assert(sizeof(Header) == 64, "records start on a cache line");
+
+// `board` before the lock, `placed` where the piece locked
+inline Record make_record(const Board &board, const Piece &placed,
+                          int next_type, int lines, uint32_t game,
+                          uint32_t piece) {
+  Record r{};
+  size_t bit = 0;
+  for (int cy = 0; cy < map_h; cy++) {
+    auto row = (uint32_t)((board.rows[(size_t)cy] & Board::cells_row) >>
+                          Board::wall_w);
+    for (int cx = 0; cx < map_w; cx++, bit++)
+      r.board[bit / 8] |= (uint8_t)(((row >> cx) & 1) << (bit % 8));
+  }
+  r.type = (uint8_t)placed.type;
+  r.angle = (uint8_t)placed.angle;
+  r.x = (int8_t)placed.x;
+  r.y = (int8_t)placed.y;
+  r.next_type = (uint8_t)next_type;
+  r.lines = (uint8_t)lines;
+  r.game = game;
+  r.piece = piece;
+  return r;
+}
+
+struct Writer {
+  // 1M records, a resize every few hours of bot play
+  static constexpr size_t grow_bytes = sizeof(Record) << 20;
+
+  int fd = -1;
+  uint8_t *map = nullptr;
+  size_t mapped = 0;
+  uint64_t records = 0;
+  std::vector<uint64_t> game_starts;
+  uint32_t pieces_this_game = 0;
+
+  Writer() = default;
+  Writer(const Writer &) = delete;
+  Writer &operator=(const Writer &) = delete;
+  ~Writer() { close(); }
+
+  [[nodiscard]] bool is_open() const { return map != nullptr; }
+
+  // truncates whatever was at `path`
+  bool open(const std::string &path) {
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return false;
+    records = 0;
+    game_starts.clear();
+    if (!remap(grow_bytes)) {
+      close();
+      return false;
+    }
+    Header h{};
+    std::memcpy(h.magic, magic, 4);
+    h.version = version;
+    h.record_size = sizeof(Record);
+    h.width = map_w;
+    h.height = map_h;
+    std::memcpy(map, &h, sizeof(h));
+    return true;
+  }
+
+  // every record after this is the next game
+  void start_game() {
+    game_starts.push_back(records);
+    pieces_this_game = 0;
+  }
+
+  void add(const Board &before, const Piece &placed, int next_type,
+           int lines) {
+    if (!is_open())
+      return;
+    if (game_starts.empty())
+      start_game();
+    size_t at = sizeof(Header) + (size_t)records * sizeof(Record);
+    if (at + sizeof(Record) > mapped && !remap(mapped + grow_bytes))
+      return;
+    Record r = make_record(before, placed, next_type, lines,
+                           (uint32_t)(game_starts.size() - 1),
+                           pieces_this_game++);
+    std::memcpy(map + at, &r, sizeof(r));
+    records++;
+    header().records = records;
+  }
+
+  // writes the index and trims the file to size
+  bool close() {
+    if (fd < 0)
+      return false;
+    bool ok = map != nullptr;
+    if (ok) {
+      size_t end = sizeof(Header) + (size_t)records * sizeof(Record);
+      size_t index_bytes = game_starts.size() * sizeof(uint64_t);
+      ok = end + index_bytes <= mapped || remap(end + index_bytes);
+      if (ok) {
+        std::memcpy(map + end, game_starts.data(), index_bytes);
+        header().index_offset = game_starts.empty() ? 0 : end;
+        header().games = game_starts.size();
+        ok = ::munmap(map, mapped) == 0 &&
+             ::ftruncate(fd, (off_t)(end + index_bytes)) == 0;
+      } else {
+        ::munmap(map, mapped);
+      }
+    }
+    ok = ::close(fd) == 0 && ok;
+    fd = -1;
+    map = nullptr;
+    mapped = 0;
+    return ok;
+  }
+
+private:
+  Header &header() { return *reinterpret_cast<Header *>(map); }
+
+  bool remap(size_t bytes) {
+    if (map)
+      ::munmap(map, mapped);
+    map = nullptr;
+    mapped = 0;
+    if (::ftruncate(fd, (off_t)bytes) != 0)
+      return false;
+    void *m =
+        ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED)
+      return false;
+    map = static_cast<uint8_t *>(m);
+    mapped = bytes;
+    return true;
+  }
+};
+
+// Maps a whole file read only, records come straight out of the page cache
+// so a file much bigger than memory is fine to walk
+struct Reader {
+  const uint8_t *map = nullptr;
+  size_t mapped = 0;
+
+  Reader() = default;
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader() { close(); }
+
+  bool open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+      ::close(fd);
+      return false;
+    }
+    void *m =
+        ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+      return false;
+    map = static_cast<const uint8_t *>(m);
+    mapped = (size_t)st.st_size;
+
+    // the counts are straight from the file, divide instead of multiplying
+    // so a huge one cant wrap around and pass
+    const Header &h = header();
+    if (std::memcmp(h.magic, magic, 4) != 0 || h.version != version ||
+        h.record_size != sizeof(Record) || h.width != map_w ||
+        h.height != map_h ||
+        h.records > (mapped - sizeof(Header)) / sizeof(Record) ||
+        (h.index_offset &&
+         (h.index_offset % sizeof(uint64_t) != 0 || h.index_offset > mapped ||
+          h.games > (mapped - h.index_offset) / sizeof(uint64_t)))) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (map)
+      ::munmap(const_cast<uint8_t *>(map), mapped);
+    map = nullptr;
+    mapped = 0;
+  }
+
+  [[nodiscard]] const Header &header() const {
+    return *reinterpret_cast<const Header *>(map);
+  }
+
+  [[nodiscard]] size_t size() const { return header().records; }
+
+  [[nodiscard]] const Record *begin() const {
+    return reinterpret_cast<const Record *>(map + sizeof(Header));
+  }
+  [[nodiscard]] const Record *end() const { return begin() + size(); }
+  [[nodiscard]] const Record &operator[](size_t i) const {
+    return begin()[i];
+  }
+
+  // 0 when the writer never got to close()
+  [[nodiscard]] size_t num_games() const {
+    return header().index_offset ? header().games : 0;
+  }
+
+  // the records of game g are [game_start(g), game_start(g + 1))
+  [[nodiscard]] size_t game_start(size_t g) const {
+    if (g >= num_games())
+      return size();
+    // open() checked the index is 8 byte aligned
+    const auto *index =
+        reinterpret_cast<const uint64_t *>(map + header().index_offset);
+    return std::min((size_t)index[g], size());
+  }
+};
+
+} // namespace dataset
@@ -0,0 +1,151 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "batch.h"
+#include "env.h"
+
+// env.h over a BatchSim, see the top of env.h for the buffer layouts
+
+static_assert((int)InputAction::Drop + 1 == TETR_NUM_ACTIONS,
+              "tetr_action and InputAction have to line up");
+static_assert(map_w <= 16, "board rows go out as uint16_t");
+
+struct tetr_env {
+  BatchSim batch;
+  // deals the games that start over after topping out, like batch.cpp
+  Rng restarts;
+  // the caller's int32 actions, checked
+  std::vector<InputAction> actions;
+  // lines_cleared as of the last step, for the rewards
+  std::vector<int32_t> lines;
+
+  tetr_env(size_t n, uint64_t seed)
+      : batch(n, seed), restarts(~seed), actions(n), lines(n) {}
+};
+
+namespace {
+
+void write_obs(const BatchSim &batch, const tetr_obs *obs) {
+  if (!obs)
+    return;
+  constexpr Board::Row cells = Board::cells_row;
+  for (size_t i = 0; i < batch.size; i++) {
+    if (obs->board) {
+      uint16_t *out = obs->board + i * (size_t)map_h;
+      for (int j = 0; j < map_h; j++) {
+        Board::Row r = batch.row(i, j) | batch.ground.rows[(size_t)j];
+        out[j] = (uint16_t)((r & cells) >> Board::wall_w);
+      }
+    }
+    if (obs->piece) {
+      int32_t *out = obs->piece + i * 4;
+      out[0] = batch.has_piece[i] ? batch.type[i] : -1;
+      out[1] = batch.angle[i];
+      out[2] = batch.x[i];
+      out[3] = batch.y[i];
+    }
+    if (obs->next_piece)
+      obs->next_piece[i] = batch.next_type[i];
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+int32_t tetr_env_abi_version(void) { return TETR_ENV_ABI_VERSION; }
+
+int32_t tetr_env_width(void) { return map_w; }
+int32_t tetr_env_height(void) { return map_h; }
+
+tetr_env *tetr_env_create(uint32_t num_games, uint64_t seed) {
+  if (num_games == 0)
+    return nullptr;
+  // nothing can throw across the C boundary
+  try {
+    tetr_env *env = new tetr_env(num_games, seed);
+    env->batch.spawn(0, env->batch.size);
+    return env;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void tetr_env_destroy(tetr_env *env) { delete env; }
+
+uint32_t tetr_env_num_games(const tetr_env *env) {
+  return (uint32_t)env->batch.size;
+}
+
+void tetr_env_reset(tetr_env *env, uint64_t seed, const tetr_obs *obs) {
+  BatchSim &batch = env->batch;
+  Rng root(seed);
+  for (size_t i = 0; i < batch.size; i++)
+    batch.reset(i, root.split());
+  env->lines.assign(batch.size, 0);
+  env->restarts = Rng(~seed);
+  batch.spawn(0, batch.size);
+  write_obs(batch, obs);
+}
+
+int32_t tetr_env_step(tetr_env *env, const int32_t *actions, float *rewards,
+                      uint8_t *dones, const tetr_obs *obs) {
+  BatchSim &batch = env->batch;
+  for (size_t i = 0; i < batch.size; i++) {
+    if (actions[i] < 0 || actions[i] >= TETR_NUM_ACTIONS)
+      return -1;
+    env->actions[i] = (InputAction)actions[i];
+  }
+
+  // the step before this one already spawned, so this only moves
+  batch.step(env->actions.data(), tick_dt);
+  for (size_t i = 0; i < batch.size; i++) {
+    int32_t now = batch.lines_cleared[i];
+    if (rewards)
+      rewards[i] = (float)(now - env->lines[i]);
+    env->lines[i] = now;
+  }
+
+  batch.spawn(0, batch.size);
+  for (size_t i = 0; i < batch.size; i++) {
+    bool over = batch.game_over[i];
+    if (dones)
+      dones[i] = over;
+    if (!over)
+      continue;
+    batch.reset(i, env->restarts.split());
+    batch.spawn(i, i + 1);
+    env->lines[i] = 0;
+  }
+  write_obs(batch, obs);
+  return 0;
+}
+
+void tetr_env_observe(const tetr_env *env, const tetr_obs *obs) {
+  write_obs(env->batch, obs);
+}
+
+void tetr_env_legal_actions(const tetr_env *env, uint8_t *legal) {
+  const BatchSim &batch = env->batch;
+  for (size_t i = 0; i < batch.size; i++) {
+    uint8_t *out = legal + i * TETR_NUM_ACTIONS;
+    for (int a = 0; a < TETR_NUM_ACTIONS; a++)
+      out[a] = a == TETR_ACTION_NONE;
+    if (!batch.has_piece[i])
+      continue;
+
+    Piece p = batch.piece(i);
+    auto coll = [&](const PieceShape &shape, int px, int py) {
+      return batch.collides(i, shape.mask, px, py);
+    };
+    const PieceMask &mask = p.shape().mask;
+    out[TETR_ACTION_LEFT] = !batch.collides(i, mask, p.x - 1, p.y);
+    out[TETR_ACTION_RIGHT] = !batch.collides(i, mask, p.x + 1, p.y);
+    out[TETR_ACTION_DOWN] = !batch.collides(i, mask, p.x, p.y + 1);
+    out[TETR_ACTION_ROTATE] = try_rotate(p, coll);
+    out[TETR_ACTION_DROP] = 1;
+  }
+}
+
+} // extern "C"
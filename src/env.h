@@ -0,0 +1,100 @@
+#ifndef TETR_ENV_H
+#define TETR_ENV_H
+
+/*
+ * The game as a vectorized environment for training, over a plain C ABI
+ *
+ * Build with `make env`, which gives libtetr_env.so. One tetr_env holds
+ * `num_games` games (a BatchSim) that all step together, load it from
+ * Python with ctypes or cffi and hand it numpy arrays.
+ *
+ * Nothing is copied out or allocated after create: step, reset and observe
+ * write straight into the buffers you pass, and a NULL buffer is skipped.
+ * Shapes for N games, everything row major:
+ *
+ *   actions        int32  [N]            one tetr_action per game
+ *   rewards        float  [N]            lines cleared this step
+ *   dones          uint8  [N]            1 if the game topped out
+ *   legal          uint8  [N][TETR_NUM_ACTIONS]
+ *   obs.board      uint16 [N][height]    bit x of a row is column x
+ *   obs.piece      int32  [N][4]         type, angle, x, y (type -1: none)
+ *   obs.next_piece int32  [N]
+ *
+ * A game that tops out is reset in the same step call, so the observation
+ * after a done is already the start of its next game.
+ *
+ * Only add to the end of this file, bump TETR_ENV_ABI_VERSION when
+ * anything here changes meaning.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TETR_ENV_ABI_VERSION 1
+
+#if defined(_WIN32)
+#define TETR_API __declspec(dllexport)
+#else
+#define TETR_API __attribute__((visibility("default")))
+#endif
+
+/* same order as InputAction in rules.h */
+enum tetr_action {
+  TETR_ACTION_NONE = 0,
+  TETR_ACTION_LEFT = 1,
+  TETR_ACTION_RIGHT = 2,
+  TETR_ACTION_ROTATE = 3,
+  TETR_ACTION_DOWN = 4,
+  TETR_ACTION_DROP = 5,
+  TETR_NUM_ACTIONS = 6
+};
+
+typedef struct tetr_env tetr_env;
+
+typedef struct tetr_obs {
+  uint16_t *board;
+  int32_t *piece;
+  int32_t *next_piece;
+} tetr_obs;
+
+/* check this against TETR_ENV_ABI_VERSION after loading the library */
+TETR_API int32_t tetr_env_abi_version(void);
+
+TETR_API int32_t tetr_env_width(void);
+TETR_API int32_t tetr_env_height(void);
+
+/* NULL if num_games is 0 or it couldnt allocate */
+TETR_API tetr_env *tetr_env_create(uint32_t num_games, uint64_t seed);
+TETR_API void tetr_env_destroy(tetr_env *env);
+
+TETR_API uint32_t tetr_env_num_games(const tetr_env *env);
+
+/* starts every game over, dealing from `seed` */
+TETR_API void tetr_env_reset(tetr_env *env, uint64_t seed,
+                             const tetr_obs *obs);
+
+/*
+ * Steps every game once by tick_dt, the action is pressed for just that
+ * step. Returns 0, or -1 without stepping if any action is out of range
+ */
+TETR_API int32_t tetr_env_step(tetr_env *env, const int32_t *actions,
+                               float *rewards, uint8_t *dones,
+                               const tetr_obs *obs);
+
+/* the games as they are now, without stepping */
+TETR_API void tetr_env_observe(const tetr_env *env, const tetr_obs *obs);
+
+/*
+ * 1 where the action would do something this step, NONE is always legal.
+ * Illegal actions are still fine to pass to step, they do nothing
+ */
+TETR_API void tetr_env_legal_actions(const tetr_env *env, uint8_t *legal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
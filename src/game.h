@@ -0,0 +1,121 @@
+#pragma once
+// not a real header either, this is the whole game minus main()
+// so main.cpp and bench.cpp can both paste it in
+
+#include "std_include.h"
+//
+#include "alloc_counter.h"
+#include "rl.h"
+
+#include "afterhours/src/entity.h"
+#include "afterhours/src/entity_helper.h"
+#include "afterhours/src/system.h"
+
+#define AFTER_HOURS_USE_RAYLIB
+using afterhours::input;
+#include "afterhours/src/developer.h"
+#include "afterhours/src/plugins/input_system.h"
+#include "afterhours/src/plugins/window_manager.h"
+#include <cassert>
+
+//
+#include "bitboard.h"
+#include "bot.h"
+#include "component_cache.h"
+#include "controls.h"
+#include "dataset.h"
+#include "occupancy.h"
+#include "piece_data.h"
+#include "profiler.h"
+#include "render_buffer.h"
+#include "replay.h"
+#include "rng.h"
+#include "rules.h"
+#include "sim.h"
+using namespace afterhours;
+
+typedef raylib::Vector2 vec2;
+typedef raylib::Vector3 vec3;
+typedef raylib::Vector4 vec4;
+
+constexpr float distance_sq(const vec2 a, const vec2 b) {
+  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+}
+
+namespace util {
+
+template <class... Ts> struct overloaded : Ts... {
+  using Ts::operator()...;
+};
+
+template <typename T> int sgn(T val) { return (T(0) < val) - (val < T(0)); }
+} // namespace util
+
+//
+const float sz = 20;
+const float szm = 0.8f;
+
+// every collidable entity that isnt the falling piece, Transform keeps it
+// up to date, see Transform::index_as
+Occupancy collision_index;
+
+// the piece that is falling right now, see ActivePiece
+ActivePiece active_piece;
+
+// what HandleInput and Fall carry from one tick to the next, kept out here
+// with active_piece so a Snapshot can copy it
+struct TickState {
+  Controls controls;
+  SimInputs last_inputs;
+  float fall_timer = startTR;
+};
+TickState tick_state;
+
+// the render systems push quads here, flushed once a frame
+RenderBuffer render_buffer;
+
+// presses to the frame that shows them, HandleInput and main() fill it in
+LatencyStats input_latency;
+
+// every lock goes in here while it is open, see dataset.h
+dataset::Writer dataset_writer;
+
+// how far into the next tick this frame is drawn, 0 to 1
+float render_alpha = 1.f;
+
+// positions are always on the sz grid, round so float error cant slip a cell
+inline int to_cell(float v) { return (int)std::lround(v / sz); }
+inline vec2 to_pos(int x, int y) { return {(float)x * sz, (float)y * sz}; }
+
+// every piece is 4 cells so this lives on the stack
+using Pips = std::array<vec2, 4>;
+
+Pips get_pips(const vec2 &pos, const PieceShape &sh) {
+  Pips my_pips;
+  for (size_t i = 0; i < my_pips.size(); i++) {
+    my_pips[i] = {
+        pos.x + (sh.cells[i].x * sz),
+        pos.y + (sh.cells[i].y * sz),
+    };
+  }
+  return my_pips;
+}
+
+bool will_collide(vec2 pos, const PieceShape &shape);
+
+// These are not real header files, im just
+// hijacking the include to paste the files here in this order
+//
+#include "colors.h"
+//
+#include "components.h"
+//
+#include "query.h"
+//
+
+using afterhours::input;
+//
+#include "systems.h"
+//
+#include "snapshot.h"
+//
@@ -0,0 +1,68 @@
+
+#include "std_include.h"
+//
+#include "bot.h"
+#include "sim.h"
+
+// Runs the game with no window as fast as it will go
+//
+//   ./tetr_headless.exe [frames] [seed] [bot]
+//
+// Inputs are random button mashing, or bot.h when the third arg is "bot".
+// Every time a game tops out we start a fresh one with the next seed
+
+SimInputs random_inputs(Rng &rng) {
+  SimInputs in;
+  in.left = rng.next_int(4) == 0;
+  in.right = rng.next_int(4) == 0;
+  in.down = rng.next_int(8) == 0;
+  in.rotate = rng.next_int(6) == 0;
+  in.drop = rng.next_int(60) == 0;
+  return in;
+}
+
+int main(int argc, char **argv) {
+  long frames = argc > 1 ? std::atol(argv[1]) : 1'000'000;
+  uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+  bool use_bot = argc > 3 && std::string_view(argv[3]) == "bot";
+
+  const float dt = tick_dt;
+
+  Rng input_rng(seed);
+  Sim sim(seed);
+  bot::Player player;
+
+  int games = 1;
+  long pieces = 0;
+  long lines = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < frames; i++) {
+    if (sim.game_over) {
+      pieces += sim.pieces_placed;
+      lines += sim.lines_cleared;
+      sim = Sim(seed + (uint64_t)games);
+      games++;
+    }
+    if (!use_bot) {
+      sim.step(random_inputs(input_rng), dt);
+      continue;
+    }
+    InputAction action = InputAction::None;
+    if (sim.has_piece)
+      action = player.act(sim.piece, sim.next_type, sim.board, sim.ground,
+                          (unsigned)sim.pieces_placed);
+    sim.step(inputs_for(action), dt);
+  }
+  auto end = std::chrono::steady_clock::now();
+  pieces += sim.pieces_placed;
+  lines += sim.lines_cleared;
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << "frames " << frames << " in " << seconds << "s ("
+            << (double)frames / seconds << " frames/s, "
+            << (double)frames * dt / seconds << "x realtime)" << std::endl;
+  std::cout << "games " << games << " pieces " << pieces << " lines " << lines
+            << std::endl;
+  return 0;
+}
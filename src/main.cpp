@@ -1,95 +1,5 @@
 
-#include "std_include.h"
-//
-#include "rl.h"
-
-#include "afterhours/src/entity.h"
-#include "afterhours/src/entity_helper.h"
-#include "afterhours/src/system.h"
-
-#define AFTER_HOURS_USE_RAYLIB
-using afterhours::input;
-#include "afterhours/src/developer.h"
-#include "afterhours/src/plugins/input_system.h"
-#include "afterhours/src/plugins/window_manager.h"
-#include <cassert>
-
-//
-#include "piece_data.h"
-using namespace afterhours;
-
-typedef raylib::Vector2 vec2;
-typedef raylib::Vector3 vec3;
-typedef raylib::Vector4 vec4;
-
-constexpr float distance_sq(const vec2 a, const vec2 b) {
-  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
-}
-
-namespace util {
-
-template <class... Ts> struct overloaded : Ts... {
-  using Ts::operator()...;
-};
-
-template <typename T> int sgn(T val) { return (T(0) < val) - (val < T(0)); }
-} // namespace util
-
-//
-const int map_h = 33;
-const int map_w = 12;
-
-const float keyReset = 0.10f;
-const float dropReset = 0.20f;
-const float rotateReset = 0.10f;
-
-const float sz = 20;
-const float szm = 0.8f;
-
-float TR = 0.25f;
-
-std::vector<vec2> get_pips(const vec2 &pos, const std::array<int, 16> &sh) {
-  std::vector<vec2> my_pips;
-  for (size_t i = 0; i < 4; i++) {
-    for (size_t j = 0; j < 4; j++) {
-      if (sh[j * 4 + i] == 0)
-        continue;
-      my_pips.push_back({
-          pos.x + (i * sz),
-          pos.y + (j * sz),
-      });
-    }
-  }
-  return my_pips;
-}
-
-bool will_collide(EntityID id, vec2 pos, const std::array<int, 16> &shape);
-void lock_entity(Entity &entity, const vec2 &pos,
-                 const std::array<int, 16> &sh);
-
-// These are not real header files, im just
-// hijacking the include to paste the files here in this order
-//
-#include "colors.h"
-//
-#include "components.h"
-//
-#include "query.h"
-//
-
-enum class InputAction {
-  None,
-  Left,
-  Right,
-  Rotate,
-  Down,
-  Drop,
-};
-
-using afterhours::input;
-//
-#include "systems.h"
-//
+#include "game.h"
 
 auto get_mapping() {
   std::map<InputAction, input::ValidInputs> mapping;
@@ -114,7 +24,7 @@ auto get_mapping() {
       raylib::GamepadButton::GAMEPAD_BUTTON_RIGHT_FACE_DOWN //
   };
 
-  mapping[InputAction::Drop] = {
+  mapping[InputAction::Down] = {
       raylib::KEY_DOWN,                                     //
       raylib::GamepadButton::GAMEPAD_BUTTON_RIGHT_FACE_LEFT //
   };
@@ -136,12 +46,144 @@ struct RenderFPS : System<window_manager::ProvidesCurrentResolution> {
   }
 };
 
+// see LatencyStats, under the fps counter
+struct RenderLatency : System<window_manager::ProvidesCurrentResolution> {
+  virtual ~RenderLatency() {}
+  virtual void for_each_with(
+      const Entity &,
+      const window_manager::ProvidesCurrentResolution &pCurrentResolution,
+      float) const override {
+    char text[64];
+    std::snprintf(text, sizeof(text), "input %.1f ms (max %.1f)",
+                  (double)input_latency.mean() * 1000.,
+                  (double)input_latency.max() * 1000.);
+    raylib::DrawText(text, (int)(pCurrentResolution.width() - 200), 20, 16,
+                     raylib::LIME);
+  }
+};
+
+// only does anything when built with -DTETR_COUNT_ALLOCS
+alloc_counter::Report alloc_report;
+
+// every system registered below, see profiler.h
+profiler::Profiler system_profiler;
+
+// the slowest systems by p99, under the input latency
+struct RenderProfiler : System<window_manager::ProvidesCurrentResolution> {
+  virtual ~RenderProfiler() {}
+  virtual void for_each_with(
+      const Entity &,
+      const window_manager::ProvidesCurrentResolution &pCurrentResolution,
+      float) const override {
+    int x = (int)(pCurrentResolution.width() - 300);
+    int y = 40;
+    raylib::DrawText("us        min     avg     p99", x + 150, y, 10,
+                     raylib::LIME);
+    for (size_t i = 0; i < system_profiler.num_slots; i++) {
+      profiler::Stats s = system_profiler.stats(i);
+      char text[96];
+      std::snprintf(text, sizeof(text), "%-24s %7.1f %7.1f %7.1f",
+                    system_profiler.slots[i].name, (double)s.min,
+                    (double)s.avg, (double)s.p99);
+      raylib::DrawText(text, x, y += 12, 10, raylib::LIME);
+    }
+  }
+};
+
+// Whatever `add` registers gets timed and has its allocations counted as
+// one system called `name`
+template <typename Add>
+void register_wrapped(SystemManager &systems, bool render, const char *name,
+                      Add &&add) {
+  auto wrap = [&](std::function<void(float)> fn) {
+    if (render)
+      systems.register_render_system(fn);
+    else
+      systems.register_update_system(fn);
+  };
+  size_t slot = system_profiler.add(name);
+  wrap([](float) {
+    if constexpr (alloc_counter::enabled)
+      alloc_report.begin_system();
+    system_profiler.begin();
+  });
+  add();
+  wrap([name, slot](float) {
+    system_profiler.end(slot);
+    if constexpr (alloc_counter::enabled)
+      alloc_report.end_system(name);
+  });
+}
+
+// `system` is a System or a plain lambda
+template <typename S>
+void register_update(SystemManager &systems, const char *name, S system) {
+  register_wrapped(systems, false, name, [&] {
+    systems.register_update_system(std::move(system));
+  });
+}
+
+template <typename S>
+void register_render(SystemManager &systems, const char *name, S system) {
+  register_wrapped(systems, true, name, [&] {
+    systems.register_render_system(std::move(system));
+  });
+}
+
 void enforce_singletons(SystemManager &systems) {
   systems.register_update_system(
       std::make_unique<afterhours::developer::EnforceSingleton<Grid>>());
+  systems.register_update_system(
+      std::make_unique<
+          afterhours::developer::EnforceSingleton<NextPieceHolder>>());
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+  //   --bot              let bot.h play
+  //   --record <file>    save an input log when the window closes
+  //   --replay <file>    play an input log back instead of reading input
+  //   --das <ms>         how long left/right is held before it repeats
+  //   --arr <ms>         time between repeats, 0 goes straight to the wall
+  //   --profile          per system timings under the fps counter
+  //   --trace <file>     save every system run as a chrome trace on exit
+  //   --dataset <file>   save every piece lock as training data, dataset.h
+  bool use_bot = false;
+  bool show_profile = false;
+  const char *trace_path = nullptr;
+  Handling handling;
+  const char *record_path = nullptr;
+  std::optional<replay::Replay> replay_log;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--bot") {
+      use_bot = true;
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_log = replay::load(argv[++i]);
+      if (!replay_log) {
+        std::cerr << "couldnt load replay " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--profile") {
+      show_profile = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (arg == "--dataset" && i + 1 < argc) {
+      if (!dataset_writer.open(argv[++i])) {
+        std::cerr << "couldnt open dataset " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--das" && i + 1 < argc) {
+      handling.das = std::strtof(argv[++i], nullptr) / 1000.f;
+    } else if (arg == "--arr" && i + 1 < argc) {
+      handling.arr = std::strtof(argv[++i], nullptr) / 1000.f;
+    }
+  }
+
+  uint64_t seed = replay_log ? replay_log->seed : 1;
+  replay::Recorder recorder(seed, tick_dt, 0);
+
   const int screenWidth = 720;
   const int screenHeight = 720;
 
@@ -154,53 +196,132 @@ int main(void) {
     input::add_singleton_components<InputAction>(entity, get_mapping());
     window_manager::add_singleton_components(
         entity, window_manager::Resolution{screenWidth, screenHeight}, 200, {});
-    entity.addComponent<NextPieceHolder>();
+    entity.addComponent<NextPieceHolder>(seed);
     entity.addComponent<Grid>();
   }
 
+  // the game runs on `systems` once per tick, `renders` draws once per frame
   SystemManager systems;
+  SystemManager renders;
+
+  // the spans everything else nests under in the trace
+  size_t frame_slot = system_profiler.add("frame");
+  size_t tick_slot = system_profiler.add("tick");
+  size_t present_slot = system_profiler.add("EndDrawing");
+  if (trace_path)
+    system_profiler.start_trace();
 
   // debug systems
-  {
+  register_wrapped(systems, false, "EnforceSingletons", [&] {
     enforce_singletons(systems);
     input::enforce_singletons<InputAction>(systems);
     window_manager::enforce_singletons(systems);
-  }
+  });
 
   // external plugins
-  { input::register_update_systems<InputAction>(systems); }
+  register_wrapped(systems, false, "InputPlugin", [&] {
+    input::register_update_systems<InputAction>(systems);
+  });
 
   // updates
   {
-    systems.register_update_system(std::make_unique<SpawnGround>());
-    systems.register_update_system(std::make_unique<SpawnPieceIfNoneFalling>());
-    systems.register_update_system(std::make_unique<ForceDrop>());
-    systems.register_update_system(std::make_unique<Rotate>());
-    systems.register_update_system(std::make_unique<Move>());
-    systems.register_update_system(std::make_unique<Fall>());
-    systems.register_update_system(std::make_unique<ClearLine>());
+    register_update(systems, "StartTick", std::make_unique<StartTick>());
+    if (replay_log)
+      register_update(systems, "ReplayInputs",
+                      std::make_unique<ReplayInputs>(std::move(*replay_log)));
+    if (use_bot)
+      register_update(systems, "BotPlayer", std::make_unique<BotPlayer>());
+    if (record_path)
+      register_update(systems, "RecordInputs",
+                      std::make_unique<RecordInputs>(recorder));
+    register_update(systems, "SpawnGround", std::make_unique<SpawnGround>());
+    register_update(systems, "SpawnPieceIfNoneFalling",
+                    std::make_unique<SpawnPieceIfNoneFalling>());
+    register_update(systems, "HandleInput",
+                    std::make_unique<HandleInput>(handling));
+    register_update(systems, "Fall", std::make_unique<Fall>());
+    register_update(systems, "ClearLine", std::make_unique<ClearLine>());
+    register_update(systems, "SyncFallingView",
+                    std::make_unique<SyncFallingView>());
   }
 
   // renders
   {
-    systems.register_render_system(
-        [](float) { raylib::ClearBackground(color::BLACK_); });
-    systems.register_render_system(std::make_unique<RenderGrid>());
-    systems.register_render_system(std::make_unique<RenderPiece>());
-    systems.register_render_system(std::make_unique<RenderGhost>());
-    systems.register_render_system(std::make_unique<RenderPreview>());
-    systems.register_render_system(
-        std::make_unique<input::RenderConnectedGamepads>());
-    systems.register_render_system(std::make_unique<RenderFPS>());
+    register_render(renders, "ClearBackground", [](float) {
+      raylib::ClearBackground(color::BLACK_);
+    });
+    register_render(renders, "RenderGrid", std::make_unique<RenderGrid>());
+    register_render(renders, "RenderPiece", std::make_unique<RenderPiece>());
+    register_render(renders, "RenderGhost", std::make_unique<RenderGhost>());
+    register_render(renders, "RenderPreview",
+                    std::make_unique<RenderPreview>());
+    register_render(renders, "FlushRenderBuffer", [](float) {
+      RaylibBackend backend;
+      render_buffer.flush(backend);
+    });
+    register_render(renders, "RenderConnectedGamepads",
+                    std::make_unique<input::RenderConnectedGamepads>());
+    register_render(renders, "RenderFPS", std::make_unique<RenderFPS>());
+    register_render(renders, "RenderLatency",
+                    std::make_unique<RenderLatency>());
+    if (show_profile)
+      register_render(renders, "RenderProfiler",
+                      std::make_unique<RenderProfiler>());
   }
 
+  // A long hitch (dragging the window, a breakpoint) would otherwise have to
+  // be caught up all at once, past this the game just runs slow for a frame
+  const float max_frame_time = 0.25f;
+  float accumulator = 0.f;
+
   while (!raylib::WindowShouldClose()) {
+    if constexpr (alloc_counter::enabled)
+      alloc_report.begin_frame();
+    auto frame_start = profiler::Clock::now();
+
+    float frame_time = std::min(raylib::GetFrameTime(), max_frame_time);
+    accumulator += frame_time;
+    while (accumulator >= tick_dt) {
+      auto tick_start = profiler::Clock::now();
+      systems.run(tick_dt);
+      system_profiler.record(tick_slot, tick_start, profiler::Clock::now());
+      accumulator -= tick_dt;
+    }
+    render_alpha = accumulator / tick_dt;
+
     raylib::BeginDrawing();
-    { systems.run(raylib::GetFrameTime()); }
+    { renders.run(frame_time); }
+    // as close to the swap as we get, EndDrawing may wait on vsync after
+    input_latency.presented(raylib::GetTime());
+    system_profiler.begin();
     raylib::EndDrawing();
+    system_profiler.end(present_slot);
+    system_profiler.record(frame_slot, frame_start, profiler::Clock::now());
+
+    if constexpr (alloc_counter::enabled)
+      alloc_report.end_frame();
   }
 
   raylib::CloseWindow();
 
+  if (input_latency.num_samples() > 0)
+    std::cout << "input latency mean " << input_latency.mean() * 1000.f
+              << "ms max " << input_latency.max() * 1000.f << "ms over "
+              << input_latency.num_samples() << " moves" << std::endl;
+
+  if (trace_path) {
+    if (!system_profiler.write_trace(trace_path))
+      std::cerr << "couldnt save trace to " << trace_path << std::endl;
+    else if (system_profiler.dropped > 0)
+      std::cerr << "trace filled up, the last " << system_profiler.dropped
+                << " runs arent in it" << std::endl;
+  }
+
+  if (record_path && !replay::save(recorder.replay, record_path))
+    std::cerr << "couldnt save replay to " << record_path << std::endl;
+
+  if (dataset_writer.is_open() && !dataset_writer.close())
+    std::cerr << "couldnt finish the dataset" << std::endl;
+
   return 0;
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bitboard.h"
+
+// Which cells are covered by collidable things that arent part of the grid,
+// the ground pieces and any other obstacles
+//
+// Keeps a count per cell so overlapping things can come and go, plus a Board
+// with a bit wherever the count isnt zero so a collision check is the same
+// mask test the grid does instead of a scan over every entity
+struct Occupancy {
+  std::array<std::array<uint8_t, map_w>, map_h> counts{};
+  Board cells;
+  // bumped on every add / remove
+  unsigned version = 0;
+
+  void add(const PieceMask &piece, int x, int y) {
+    version++;
+    for_each_cell(piece, x, y, [&](int xx, int yy) {
+      uint8_t &count = counts[(size_t)yy][(size_t)xx];
+      if (count++ == 0)
+        cells.set(xx, yy);
+    });
+  }
+
+  void remove(const PieceMask &piece, int x, int y) {
+    version++;
+    for_each_cell(piece, x, y, [&](int xx, int yy) {
+      uint8_t &count = counts[(size_t)yy][(size_t)xx];
+      if (count == 0)
+        return;
+      if (--count == 0)
+        cells.unset(xx, yy);
+    });
+  }
+
+  [[nodiscard]] bool collides(const PieceMask &piece, int x, int y) const {
+    return cells.collides(piece, x, y);
+  }
+
+private:
+  // only the cells that are on the board, nothing can hit the rest
+  template <typename Fn>
+  static void for_each_cell(const PieceMask &piece, int x, int y, Fn &&fn) {
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        if (!((piece.rows[(size_t)r] >> c) & 1))
+          continue;
+        int xx = x + c;
+        int yy = y + r;
+        if (xx < 0 || xx >= map_w || yy < 0 || yy >= map_h)
+          continue;
+        fn(xx, yy);
+      }
+    }
+  }
+};
@@ -12,88 +12,73 @@
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #endif
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
+
+#include "bitboard.h"
 
 // pieces and rotations come from:
 // they are 4x4 clockwise rotating
 // https://tetris.wiki/File:SRS-pieces.png
-const std::array<int, 4> tower = {{
+constexpr std::array<int, 4> tower = {{
     0b1111000000000000,
     0b0010001000100010,
     0b0000000011110000,
     0b0100010001000100,
 }};
 
-const std::array<int, 4> box = {{
+constexpr std::array<int, 4> box = {{
     0b0110011000000000,
     0b0110011000000000,
     0b0110011000000000,
     0b0110011000000000,
 }};
 
-const std::array<int, 4> pyramid = {{
+constexpr std::array<int, 4> pyramid = {{
     0b0100111000000000,
     0b0100011001000000,
     0b0000111001000000,
     0b0100110001000000,
 }};
 
-const std::array<int, 4> leftlean = {{
+constexpr std::array<int, 4> leftlean = {{
     0b1100011000000000,
     0b0010011001000000,
     0b0000110001100000,
     0b0100110010000000,
 }};
 
-const std::array<int, 4> rightlean = {{
+constexpr std::array<int, 4> rightlean = {{
     0b0110110000000000,
     0b0100011000100000,
     0b0000011011000000,
     0b1000110001000000,
 }};
 
-const std::array<int, 4> leftknight = {{
+constexpr std::array<int, 4> leftknight = {{
     0b1000111000000000,
     0b0110010001000000,
     0b0000111000100000,
     0b0100010011000000,
 }};
 
-const std::array<int, 4> rightknight = {{
+constexpr std::array<int, 4> rightknight = {{
     0b0010111000000000,
     0b0110010001000000,
     0b0000111000100000,
     0b0100010011000000,
 }};
 
-inline std::array<int, 16> bit_to_array(int b) {
-  std::array<int, 16> tmp;
-  int j = 0;
-  for (int i = 15; i >= 0; i--) {
-    tmp[j++] = (b >> i) & 1;
-  }
-  return tmp;
-}
+struct Cell {
+  int8_t x;
+  int8_t y;
+};
 
-inline std::array<int, 16> type_to_rotated_array(int t, int a) {
-  if (t == 0)
-    return bit_to_array(tower[a]);
-  if (t == 1)
-    return bit_to_array(box[a]);
-  if (t == 2)
-    return bit_to_array(pyramid[a]);
-  if (t == 3)
-    return bit_to_array(leftlean[a]);
-  if (t == 4)
-    return bit_to_array(rightlean[a]);
-  if (t == 5)
-    return bit_to_array(leftknight[a]);
-  if (t == 6)
-    return bit_to_array(rightknight[a]);
-  return bit_to_array(0);
-}
+using Kicks = std::array<Cell, 4>;
 
-const std::array<std::array<std::pair<int, int>, 4>, 4> long_boi_tests = {{
+// indexed by the angle you are rotating into
+constexpr std::array<Kicks, 4> long_boi_tests = {{
     {{
         {-2, +0},
         {+1, +0},
@@ -120,7 +105,7 @@ const std::array<std::array<std::pair<int, int>, 4>, 4> long_boi_tests = {{
     }},
 }};
 
-std::array<std::array<std::pair<int, int>, 4>, 4> wall_kick_tests = {{
+constexpr std::array<Kicks, 4> wall_kick_tests = {{
     {{
         {-1, +0},
         {-1, +1},
@@ -147,6 +132,107 @@ std::array<std::array<std::pair<int, int>, 4>, 4> wall_kick_tests = {{
     }},
 }};
 
+constexpr int num_piece_types = 7;
+constexpr int num_angles = 4;
+
+// Everything we need to know about one (type, angle)
+// built once at compile time so rotating is just a table lookup
+struct PieceShape {
+  uint16_t bits;
+  PieceMask mask;
+  // offsets of the 4 filled cells inside the 4x4 box
+  std::array<Cell, 4> cells;
+  // inclusive bounding box of the filled cells
+  Cell min;
+  Cell max;
+  // kicks to try when rotating into this angle
+  Kicks kicks;
+};
+
+constexpr std::array<std::array<int, 4>, num_piece_types> piece_bits = {{
+    tower,
+    box,
+    pyramid,
+    leftlean,
+    rightlean,
+    leftknight,
+    rightknight,
+}};
+
+// bit 15 is the top left of the 4x4 box, read left to right top to bottom
+constexpr bool bit_is_set(int b, int x, int y) {
+  return (b >> (15 - (y * 4 + x))) & 1;
+}
+
+constexpr PieceShape make_piece_shape(int t, int a) {
+  int b = piece_bits[(size_t)t][(size_t)a];
+  PieceShape shape{};
+  shape.bits = (uint16_t)b;
+  shape.min = {3, 3};
+  shape.max = {0, 0};
+  shape.kicks = t == 0 ? long_boi_tests[(size_t)a] : wall_kick_tests[(size_t)a];
+
+  size_t n = 0;
+  for (int8_t y = 0; y < 4; y++) {
+    for (int8_t x = 0; x < 4; x++) {
+      if (!bit_is_set(b, x, y))
+        continue;
+      shape.mask.rows[(size_t)y] =
+          (uint8_t)(shape.mask.rows[(size_t)y] | (1 << x));
+      shape.mask.bottom[(size_t)x] = y;
+      if (n < shape.cells.size())
+        shape.cells[n] = {x, y};
+      n++;
+      shape.min = {std::min(shape.min.x, x), std::min(shape.min.y, y)};
+      shape.max = {std::max(shape.max.x, x), std::max(shape.max.y, y)};
+    }
+  }
+  return shape;
+}
+
+constexpr auto piece_table = [] {
+  std::array<std::array<PieceShape, num_angles>, num_piece_types> table{};
+  for (int t = 0; t < num_piece_types; t++)
+    for (int a = 0; a < num_angles; a++)
+      table[(size_t)t][(size_t)a] = make_piece_shape(t, a);
+  return table;
+}();
+
+constexpr const PieceShape &piece_shape(int t, int a) {
+  return piece_table[(size_t)t][(size_t)a];
+}
+
+constexpr int count_bits(int b) {
+  int n = 0;
+  for (; b; b &= b - 1)
+    n++;
+  return n;
+}
+
+constexpr bool piece_table_is_valid() {
+  for (int t = 0; t < num_piece_types; t++) {
+    for (int a = 0; a < num_angles; a++) {
+      const PieceShape &shape = piece_shape(t, a);
+      if (count_bits(shape.bits) != 4)
+        return false;
+      if (shape.min.x > shape.max.x || shape.min.y > shape.max.y)
+        return false;
+      for (Cell c : shape.cells)
+        if (!bit_is_set(shape.bits, c.x, c.y))
+          return false;
+    }
+  }
+  return true;
+}
+
+static_assert(piece_table_is_valid(), "every piece needs exactly 4 cells");
+static_assert(piece_shape(1, 0).bits == piece_shape(1, 3).bits,
+              "the box doesnt rotate");
+static_assert(piece_shape(0, 0).max.x - piece_shape(0, 0).min.x == 3,
+              "the long boi is 4 wide when flat");
+static_assert(piece_shape(0, 1).kicks[0].x == long_boi_tests[1][0].x,
+              "the long boi uses its own kick table");
+
 #ifdef __APPLE__
 #pragma clang diagnostic pop
 #else
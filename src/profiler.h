@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// How long every system takes, always on
+//
+// main() wraps each registered system in begin / end (see register_update
+// in main.cpp). Every run is one sample, the last `window` of them per
+// system give the min/avg/p99 the overlay shows. With a trace started, every
+// run is also kept as a Chrome trace event, open the file in Perfetto or
+// chrome://tracing to see which system owns a spike
+//
+// Nothing here allocates once the slots are added and the trace is started
+
+namespace profiler {
+
+using Clock = std::chrono::steady_clock;
+
+struct Stats {
+  // all in microseconds
+  float min = 0.f;
+  float avg = 0.f;
+  float p99 = 0.f;
+  float max = 0.f;
+};
+
+struct Profiler {
+  static constexpr size_t max_slots = 64;
+  // about a second of ticks
+  static constexpr size_t window = 256;
+
+  struct Slot {
+    const char *name;
+    // a ring of the most recent runs in microseconds
+    std::array<float, window> samples;
+    size_t count;
+  };
+
+  struct Event {
+    uint32_t slot;
+    // since `epoch`, in nanoseconds
+    int64_t start;
+    int64_t duration;
+  };
+
+  std::array<Slot, max_slots> slots{};
+  size_t num_slots = 0;
+
+  Clock::time_point epoch = Clock::now();
+  Clock::time_point started;
+
+  std::vector<Event> trace;
+  bool tracing = false;
+  // events past the reserved space, the trace just stops there
+  long dropped = 0;
+
+  // returns the slot to pass to end(), call once per system at startup
+  size_t add(const char *name) {
+    if (num_slots == max_slots)
+      return max_slots;
+    slots[num_slots].name = name;
+    return num_slots++;
+  }
+
+  void begin() { started = Clock::now(); }
+
+  void end(size_t slot) { record(slot, started, Clock::now()); }
+
+  // for spans that nest around systems, like a whole frame or tick
+  void record(size_t slot, Clock::time_point from, Clock::time_point to) {
+    if (slot >= num_slots)
+      return;
+    Slot &s = slots[slot];
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from)
+                  .count();
+    s.samples[s.count++ % window] = (float)ns / 1000.f;
+
+    if (!tracing)
+      return;
+    if (trace.size() == trace.capacity()) {
+      dropped++;
+      return;
+    }
+    auto start =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(from - epoch)
+            .count();
+    trace.push_back(Event{(uint32_t)slot, start, ns});
+  }
+
+  // keeps up to `max_events` runs, at 240 ticks a second and a dozen
+  // systems the default is a few minutes
+  void start_trace(size_t max_events = 1 << 21) {
+    trace.clear();
+    trace.reserve(max_events);
+    dropped = 0;
+    tracing = true;
+  }
+
+  [[nodiscard]] Stats stats(size_t slot) const {
+    Stats out;
+    if (slot >= num_slots)
+      return out;
+    const Slot &s = slots[slot];
+    size_t n = std::min(s.count, window);
+    if (n == 0)
+      return out;
+
+    std::array<float, window> sorted;
+    std::copy(s.samples.begin(), s.samples.begin() + (long)n, sorted.begin());
+    float sum = 0.f;
+    for (size_t i = 0; i < n; i++)
+      sum += sorted[i];
+    // the sample 99% of runs were at or under
+    size_t p = (n * 99 + 99) / 100 - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + (long)p,
+                     sorted.begin() + (long)n);
+    out.p99 = sorted[p];
+    out.min = *std::min_element(sorted.begin(), sorted.begin() + (long)n);
+    out.max = *std::max_element(sorted.begin(), sorted.begin() + (long)n);
+    out.avg = sum / (float)n;
+    return out;
+  }
+
+  // Chrome trace event format, one complete ("X") event per run
+  bool write_trace(const char *path) const {
+    FILE *file = std::fopen(path, "w");
+    if (!file)
+      return false;
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    for (size_t i = 0; i < trace.size(); i++) {
+      const Event &e = trace[i];
+      // ts and dur are microseconds, fractions are fine
+      std::fprintf(file,
+                   "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                   "\"ts\":%.3f,\"dur\":%.3f}\n",
+                   i ? "," : "", slots[e.slot].name,
+                   (double)e.start / 1000., (double)e.duration / 1000.);
+    }
+    std::fputs("]}\n", file);
+    return std::fclose(file) == 0;
+  }
+};
+
+} // namespace profiler
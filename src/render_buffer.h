@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Everything the board draws is a colored quad, so instead of every render
+// system calling DrawRectangleV per cell they push into a RenderBuffer that
+// gets flushed once a frame. The flush sorts so each (layer, color) run goes
+// out as one batch
+//
+// A backend is anything with draw_batch(Rgba, const Quad *, size_t)
+// see RecordingBackend below and RaylibBackend in systems.h
+
+struct Rgba {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+
+  [[nodiscard]] uint32_t packed() const {
+    return (uint32_t)r << 24 | (uint32_t)g << 16 | (uint32_t)b << 8 | a;
+  }
+};
+
+// drawn in this order, color sorting only happens inside a layer so
+// see-through things still land on top of what they cover
+enum class Layer : uint8_t {
+  Board,
+  Piece,
+  Ghost,
+  Ui,
+};
+
+struct Quad {
+  float x;
+  float y;
+  float w;
+  float h;
+  Rgba color;
+  Layer layer;
+
+  [[nodiscard]] uint64_t sort_key() const {
+    return (uint64_t)layer << 32 | color.packed();
+  }
+};
+
+struct RenderBuffer {
+  std::vector<Quad> quads;
+
+  // sized for a full board plus pieces so a normal frame never grows it
+  RenderBuffer() { quads.reserve(1024); }
+
+  void push(const Quad &quad) { quads.push_back(quad); }
+
+  template <typename Backend> void flush(Backend &backend) {
+    std::sort(quads.begin(), quads.end(), [](const Quad &a, const Quad &b) {
+      return a.sort_key() < b.sort_key();
+    });
+
+    size_t start = 0;
+    for (size_t i = 1; i <= quads.size(); i++) {
+      if (i < quads.size() &&
+          quads[i].sort_key() == quads[start].sort_key())
+        continue;
+      backend.draw_batch(quads[start].color, quads.data() + start, i - start);
+      start = i;
+    }
+    quads.clear();
+  }
+};
+
+// Draws nothing, just counts what would have gone to the gpu
+// so draw calls and frame build cost can be looked at with no gl context
+struct RecordingBackend {
+  size_t draw_calls = 0;
+  size_t quads = 0;
+
+  void draw_batch(Rgba, const Quad *, size_t n) {
+    draw_calls++;
+    quads += n;
+  }
+};
@@ -0,0 +1,141 @@
+#include "std_include.h"
+//
+#include "bot.h"
+#include "replay.h"
+
+// Makes and plays back input logs with no window
+//
+//   ./tetr_replay.exe record <file> [frames] [seed]
+//   ./tetr_replay.exe play <file>
+//   ./tetr_replay.exe seek <file> <frame>
+//   ./tetr_replay.exe verify <file>
+//
+// record has the bot play and keeps a keyframe every 10 seconds of game.
+// play runs the whole log as a repeatable workload, seek jumps to a frame
+// and verify replays from the start checking every keyframe matches, which
+// is how a desync shows up
+
+const uint32_t keyframe_every = (uint32_t)tick_rate * 10;
+
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start)
+      .count();
+}
+
+void print_state(const Sim &sim) {
+  std::cout << "pieces " << sim.pieces_placed << " lines "
+            << sim.lines_cleared << (sim.game_over ? " game over" : "")
+            << " digest " << std::hex << replay::digest(sim) << std::dec
+            << std::endl;
+}
+
+int cmd_record(const char *path, uint32_t frames, uint64_t seed) {
+  const float dt = tick_dt;
+  Sim sim(seed);
+  bot::Config config;
+  config.threads = 1;
+  bot::Player player(config);
+  replay::Recorder recorder(seed, dt, keyframe_every);
+
+  for (uint32_t i = 0; i < frames && !sim.game_over; i++) {
+    InputAction action = InputAction::None;
+    if (sim.has_piece)
+      action = player.act(sim.piece, sim.next_type, sim.board, sim.ground,
+                          (unsigned)sim.pieces_placed);
+    SimInputs in = inputs_for(action);
+    recorder.record(in, &sim);
+    sim.step(in, dt);
+  }
+
+  if (!replay::save(recorder.replay, path)) {
+    std::cerr << "couldnt write " << path << std::endl;
+    return 1;
+  }
+  std::cout << "recorded " << recorder.replay.frames << " frames, "
+            << recorder.replay.events.size() << " bytes of inputs and "
+            << recorder.replay.keyframes.size() << " keyframes" << std::endl;
+  print_state(sim);
+  return 0;
+}
+
+int cmd_play(const replay::Replay &log) {
+  auto start = clock_type::now();
+  Sim sim = replay::seek(log, log.frames);
+  double ms = ms_since(start);
+  // seek would start from the last keyframe, this is the full workload
+  start = clock_type::now();
+  Sim full(log.seed);
+  for (replay::Player player(log); !player.done();)
+    full.step(player.next(), log.dt);
+  double full_ms = ms_since(start);
+
+  std::cout << log.frames << " frames in " << full_ms << "ms ("
+            << (double)log.frames / full_ms * 1000. << " frames/s), "
+            << ms << "ms from the last keyframe" << std::endl;
+  print_state(full);
+  return replay::digest(sim) == replay::digest(full) ? 0 : 1;
+}
+
+int cmd_seek(const replay::Replay &log, uint32_t frame) {
+  auto start = clock_type::now();
+  Sim sim = replay::seek(log, frame);
+  std::cout << "frame " << frame << " in " << ms_since(start) << "ms"
+            << std::endl;
+  print_state(sim);
+  return 0;
+}
+
+int cmd_verify(const replay::Replay &log) {
+  if (log.keyframes.empty()) {
+    std::cout << "no keyframes to check against" << std::endl;
+    return 0;
+  }
+  Sim sim(log.seed);
+  replay::Player player(log);
+  for (size_t k = 0; k < log.keyframes.size(); k++) {
+    uint32_t frame = (uint32_t)k * log.keyframe_every;
+    while (player.frame < frame)
+      sim.step(player.next(), log.dt);
+    if (replay::digest(sim) != replay::digest(log.keyframes[k].sim)) {
+      std::cout << "desync between frame "
+                << (k ? frame - log.keyframe_every : 0) << " and " << frame
+                << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "all " << log.keyframes.size() << " keyframes match"
+            << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: tetr_replay.exe record|play|seek|verify <file> ..."
+              << std::endl;
+    return 1;
+  }
+  std::string_view cmd = argv[1];
+  const char *path = argv[2];
+
+  if (cmd == "record")
+    return cmd_record(path,
+                  argc > 3 ? (uint32_t)std::strtoul(argv[3], nullptr, 10)
+                           : 200'000,
+                  argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1);
+
+  std::optional<replay::Replay> log = replay::load(path);
+  if (!log) {
+    std::cerr << "couldnt load " << path << std::endl;
+    return 1;
+  }
+  if (cmd == "play")
+    return cmd_play(*log);
+  if (cmd == "seek" && argc > 3)
+    return cmd_seek(*log, (uint32_t)std::strtoul(argv[3], nullptr, 10));
+  if (cmd == "verify")
+    return cmd_verify(*log);
+  std::cerr << "unknown command " << cmd << std::endl;
+  return 1;
+}
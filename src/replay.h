@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "sim.h"
+
+// Input logs that play a game back exactly
+//
+// A replay is the piece seed, the step size and then only the frames where
+// the held buttons changed, as (frames since the last change, buttons).
+// Every keyframe_every frames a copy of the whole Sim is kept so seeking
+// starts from the nearest keyframe instead of frame zero
+//
+// File layout, little endian, everything packed:
+//
+//   "TRPL" u16 version u16 sizeof(Sim)
+//   u64 seed  f32 dt  u32 keyframe_every  u32 frames
+//   u32 event bytes, then the events
+//     varint frames since the last event, u8 buttons
+//   u32 keyframes, then each keyframe
+//     u32 event byte offset  u32 frame of the last event  u8 buttons
+//     the Sim, as raw bytes
+//
+// the keyframes are raw Sims so a replay only loads in the build that made
+// it, the sizeof check catches the obvious mismatches
+
+static_assert(std::is_trivially_copyable_v<Sim>,
+              "keyframes copy the Sim byte for byte");
+
+namespace replay {
+
+constexpr char magic[4] = {'T', 'R', 'P', 'L'};
+constexpr uint16_t version = 2;
+
+using Buttons = uint8_t;
+
+inline Buttons pack(const SimInputs &in) {
+  return (Buttons)((in.left ? 1 : 0) | (in.right ? 2 : 0) |
+                   (in.down ? 4 : 0) | (in.rotate ? 8 : 0) |
+                   (in.drop ? 16 : 0));
+}
+
+inline SimInputs unpack(Buttons b) {
+  SimInputs in;
+  in.left = b & 1;
+  in.right = b & 2;
+  in.down = b & 4;
+  in.rotate = b & 8;
+  in.drop = b & 16;
+  return in;
+}
+
+// where we are in the event stream
+struct Cursor {
+  uint32_t offset = 0;
+  uint32_t last_event = 0;
+  Buttons buttons = 0;
+};
+
+struct Keyframe {
+  Cursor cursor;
+  Sim sim{0};
+};
+
+struct Replay {
+  uint64_t seed = 0;
+  float dt = tick_dt;
+  uint32_t keyframe_every = 0;
+  uint32_t frames = 0;
+  std::vector<uint8_t> events;
+  std::vector<Keyframe> keyframes;
+};
+
+struct Recorder {
+  Replay replay;
+  Cursor cursor;
+
+  Recorder(uint64_t seed, float dt, uint32_t keyframe_every) {
+    replay.seed = seed;
+    replay.dt = dt;
+    replay.keyframe_every = keyframe_every;
+  }
+
+  // call before stepping with these inputs, `sim` is the state going in
+  void record(const SimInputs &in, const Sim *sim = nullptr) {
+    uint32_t frame = replay.frames++;
+    if (sim && replay.keyframe_every &&
+        frame % replay.keyframe_every == 0)
+      replay.keyframes.push_back(Keyframe{cursor, *sim});
+
+    Buttons b = pack(in);
+    if (b == cursor.buttons)
+      return;
+    // 7 bits at a time, the high bit says theres more
+    uint32_t delta = frame - cursor.last_event;
+    for (; delta >= 0x80; delta >>= 7)
+      replay.events.push_back((uint8_t)(delta | 0x80));
+    replay.events.push_back((uint8_t)delta);
+    replay.events.push_back(b);
+    cursor = Cursor{(uint32_t)replay.events.size(), frame, b};
+  }
+};
+
+// hands back the inputs for each frame in order
+struct Player {
+  const Replay &replay;
+  Cursor cursor;
+  uint32_t frame = 0;
+
+  explicit Player(const Replay &r, Cursor c = Cursor{}, uint32_t f = 0)
+      : replay(r), cursor(c), frame(f) {}
+
+  [[nodiscard]] bool done() const { return frame >= replay.frames; }
+
+  SimInputs next() {
+    if (cursor.offset < replay.events.size()) {
+      uint32_t delta = 0;
+      uint32_t offset = cursor.offset;
+      for (int shift = 0;; shift += 7) {
+        uint8_t byte = replay.events[offset++];
+        delta |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+          break;
+      }
+      if (cursor.last_event + delta == frame)
+        cursor = Cursor{offset + 1, frame, replay.events[offset]};
+    }
+    frame++;
+    return unpack(cursor.buttons);
+  }
+};
+
+// The game as it was going into `frame`
+//
+// starts from the keyframe at or before it, so this is at most
+// keyframe_every steps no matter how long the replay is
+inline Sim seek(const Replay &replay, uint32_t frame) {
+  if (!replay.keyframe_every || replay.keyframes.empty()) {
+    Sim sim(replay.seed);
+    Player player(replay);
+    while (player.frame < frame && !player.done())
+      sim.step(player.next(), replay.dt);
+    return sim;
+  }
+
+  size_t k = std::min((size_t)(frame / replay.keyframe_every),
+                      replay.keyframes.size() - 1);
+  Sim sim = replay.keyframes[k].sim;
+  Player player(replay, replay.keyframes[k].cursor,
+                (uint32_t)k * replay.keyframe_every);
+  while (player.frame < frame && !player.done())
+    sim.step(player.next(), replay.dt);
+  return sim;
+}
+
+// FNV-1a over everything that decides how the game goes from here, two
+// Sims that match on this play out the same
+inline uint64_t digest(const Sim &sim) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  auto mix = [&](uint64_t v) {
+    for (int i = 0; i < 8; i++, v >>= 8)
+      h = (h ^ (v & 0xff)) * 0x100000001b3ull;
+  };
+  auto mix_float = [&](float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    mix(bits);
+  };
+  for (Board::Row row : sim.board.rows)
+    mix(row);
+  mix((uint64_t)sim.piece.type << 48 | (uint64_t)sim.piece.angle << 32 |
+      (uint64_t)(uint16_t)sim.piece.x << 16 | (uint16_t)sim.piece.y);
+  mix((uint64_t)sim.has_piece << 8 | (uint64_t)sim.game_over);
+  mix((uint64_t)sim.next_type);
+  mix(sim.rng.state);
+  mix(sim.dirty_rows);
+  mix((uint64_t)sim.lines_cleared << 32 | (uint32_t)sim.pieces_placed);
+  mix_float(sim.since_last_input);
+  mix_float(sim.fall_timer);
+  mix(pack(sim.last_inputs));
+  mix(pack(sim.controls.held));
+  mix((uint64_t)(int64_t)sim.controls.shift_dir);
+  mix_float(sim.controls.das_timer);
+  mix_float(sim.controls.arr_timer);
+  mix_float(sim.controls.soft_timer);
+  return h;
+}
+
+namespace detail {
+template <typename T> void put(std::vector<uint8_t> &out, const T &v) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&v);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> bool get(const std::vector<uint8_t> &in, size_t &at,
+                               T &v) {
+  if (at + sizeof(T) > in.size())
+    return false;
+  std::memcpy(&v, in.data() + at, sizeof(T));
+  at += sizeof(T);
+  return true;
+}
+
+// a bool that came in as raw bytes, anything but 0 or 1 is a corrupt file
+// and reading it as a bool would be undefined
+inline bool valid(const bool &b) {
+  uint8_t byte;
+  std::memcpy(&byte, &b, 1);
+  return byte <= 1;
+}
+
+inline bool valid(const SimInputs &in) {
+  return valid(in.left) && valid(in.right) && valid(in.down) &&
+         valid(in.rotate) && valid(in.drop);
+}
+
+// both ends included, false for NaN
+template <typename T> bool in_range(T v, T lo, T hi) {
+  return v >= lo && v <= hi;
+}
+
+// the column heights are used as row numbers and the floor is what stops
+// a piece falling off the bottom
+inline bool valid(const Board &board) {
+  for (int8_t top : board.tops)
+    if (!in_range<int>(top, 0, map_h))
+      return false;
+  for (int j = map_h; j < Board::rows_h; j++)
+    if (board.rows[(size_t)j] != Board::solid_row)
+      return false;
+  return true;
+}
+
+// Everything in a keyframe's Sim that stepping indexes with or loops on.
+// The piece has to be a real shape somewhere collides() can look, and the
+// timers have to be where Controls::update leaves them, a soft_timer way
+// below 0 would spin its catch up loop forever. das_timer and fall_timer
+// really do go below 0 between steps so those only have to be finite
+inline bool valid(const Sim &sim) {
+  constexpr float inf = HUGE_VALF;
+  const Piece &p = sim.piece;
+  const Controls &c = sim.controls;
+  const Handling &h = c.handling;
+  if (!valid(sim.has_piece) || !valid(sim.game_over) ||
+      !valid(sim.last_inputs) || !valid(c.held) || !valid(sim.board) ||
+      !valid(sim.ground))
+    return false;
+  if (sim.has_piece &&
+      !(in_range(p.type, 0, num_piece_types - 1) &&
+        in_range(p.angle, 0, num_angles - 1) &&
+        in_range(p.x, -Board::wall_w, map_w - 1) &&
+        in_range(p.y, -4, Board::rows_h - 1)))
+    return false;
+  return in_range(sim.next_type, 0, num_piece_types - 1) &&
+         sim.lines_cleared >= 0 && sim.pieces_placed >= 0 &&
+         in_range(sim.last_clear.count, 0, 4) &&
+         in_range(sim.since_last_input, 0.f, inf) &&
+         in_range(sim.fall_timer, -inf, startTR) &&
+         in_range(c.shift_dir, -1, 1) && in_range(h.das, 0.f, inf) &&
+         in_range(c.das_timer, -inf, h.das) && std::isfinite(h.arr) &&
+         (h.arr <= 0.f || h.arr >= 0.001f) &&
+         in_range(c.arr_timer, 0.f, std::max(h.arr, 0.f)) &&
+         in_range(h.soft_drop, 0.001f, inf) &&
+         in_range(c.soft_timer, 0.f, h.soft_drop);
+}
+
+// Walks the events the way Player::next does and returns the cursor after
+// each one, in order. Empty if a varint runs past 5 bytes or the end, or
+// isnt followed by its buttons
+inline std::optional<std::vector<Cursor>>
+scan_events(const std::vector<uint8_t> &events) {
+  std::vector<Cursor> out;
+  Cursor cursor;
+  for (size_t at = 0; at < events.size();) {
+    uint32_t delta = 0;
+    int bytes = 0;
+    for (;; bytes++) {
+      // 5 bytes is 35 bits, the last one can only hold the top 4
+      if (at == events.size() || bytes == 5 ||
+          (bytes == 4 && events[at] > 0x0f))
+        return {};
+      uint8_t byte = events[at++];
+      delta |= (uint32_t)(byte & 0x7f) << (7 * bytes);
+      if (!(byte & 0x80))
+        break;
+    }
+    if (at == events.size())
+      return {};
+    Buttons b = events[at++];
+    cursor = Cursor{(uint32_t)at, cursor.last_event + delta, b};
+    out.push_back(cursor);
+  }
+  return out;
+}
+
+// a keyframe has to start on one of the cursors scan_events found (or the
+// very start) and agree with it, or Player would decode from the middle of
+// an event
+inline bool valid(const Cursor &c, const std::vector<Cursor> &cursors) {
+  if (c.offset == 0)
+    return c.last_event == 0 && c.buttons == 0;
+  auto it = std::lower_bound(
+      cursors.begin(), cursors.end(), c.offset,
+      [](const Cursor &a, uint32_t offset) { return a.offset < offset; });
+  return it != cursors.end() && it->offset == c.offset &&
+         it->last_event == c.last_event && it->buttons == c.buttons;
+}
+} // namespace detail
+
+inline bool save(const Replay &replay, const std::string &path) {
+  std::vector<uint8_t> out;
+  out.insert(out.end(), magic, magic + 4);
+  detail::put(out, version);
+  detail::put(out, (uint16_t)sizeof(Sim));
+  detail::put(out, replay.seed);
+  detail::put(out, replay.dt);
+  detail::put(out, replay.keyframe_every);
+  detail::put(out, replay.frames);
+  detail::put(out, (uint32_t)replay.events.size());
+  out.insert(out.end(), replay.events.begin(), replay.events.end());
+  detail::put(out, (uint32_t)replay.keyframes.size());
+  for (const Keyframe &k : replay.keyframes) {
+    detail::put(out, k.cursor.offset);
+    detail::put(out, k.cursor.last_event);
+    detail::put(out, k.cursor.buttons);
+    detail::put(out, k.sim);
+  }
+
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+inline std::optional<Replay> load(const std::string &path) {
+  FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return {};
+  std::vector<uint8_t> in;
+  uint8_t chunk[4096];
+  for (size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) > 0;)
+    in.insert(in.end(), chunk, chunk + n);
+  std::fclose(file);
+
+  size_t at = 0;
+  char m[4];
+  uint16_t v = 0;
+  uint16_t sim_size = 0;
+  Replay replay;
+  uint32_t num = 0;
+  if (!detail::get(in, at, m) || std::memcmp(m, magic, 4) != 0 ||
+      !detail::get(in, at, v) || v != version ||
+      !detail::get(in, at, sim_size) || sim_size != sizeof(Sim) ||
+      !detail::get(in, at, replay.seed) || !detail::get(in, at, replay.dt) ||
+      !detail::get(in, at, replay.keyframe_every) ||
+      !detail::get(in, at, replay.frames) || !detail::get(in, at, num) ||
+      at + num > in.size())
+    return {};
+  replay.events.assign(in.begin() + (long)at, in.begin() + (long)(at + num));
+  at += num;
+  // Player::next trusts every event to be whole
+  std::optional<std::vector<Cursor>> cursors =
+      detail::scan_events(replay.events);
+  if (!cursors || !(replay.dt > 0.f && replay.dt <= 1.f))
+    return {};
+
+  // the count is from the file, make sure that many are really there
+  // before allocating for them
+  const size_t keyframe_bytes = sizeof(uint32_t) * 2 + sizeof(Buttons) +
+                                sizeof(Sim);
+  if (!detail::get(in, at, num) || num > (in.size() - at) / keyframe_bytes)
+    return {};
+  replay.keyframes.resize(num);
+  for (Keyframe &k : replay.keyframes) {
+    if (!detail::get(in, at, k.cursor.offset) ||
+        !detail::get(in, at, k.cursor.last_event) ||
+        !detail::get(in, at, k.cursor.buttons) ||
+        !detail::valid(k.cursor, *cursors) ||
+        !detail::get(in, at, k.sim) || !detail::valid(k.sim))
+      return {};
+  }
+  return replay;
+}
+
+} // namespace replay
@@ -19,6 +19,7 @@
 namespace raylib {
 #include "RaylibOpOverloads.h"
 #include "raylib.h"
+#include "rlgl.h"
 
 } // namespace raylib
 #include <GLFW/glfw3.h>
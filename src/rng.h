@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// splitmix64, tiny and good enough for picking pieces
+// unlike rand() each game gets its own and the same seed plays out the same
+struct Rng {
+  uint64_t state;
+
+  explicit Rng(uint64_t seed = 0) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // [0, n)
+  int next_int(int n) { return (int)(next() % (uint64_t)n); }
+
+  // A new generator that wont overlap this one, for handing each game its
+  // own stream. Splitting in the same order always gives the same children
+  Rng split() { return Rng(next() ^ 0x6a09e667f3bcc909ull); }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <type_traits>
+
+#include "bitboard.h"
+#include "piece_data.h"
+
+// The actual game rules, with no raylib or ecs in here
+// systems.h and sim.h both go through these so they cant drift apart
+
+// the game always moves forward in steps of exactly this long, however fast
+// frames come in, so it plays the same on every machine
+const float tick_rate = 240.f;
+const float tick_dt = 1.f / tick_rate;
+
+// seconds per row of gravity. It stays put, the original sped up on line
+// clears but that never reached the falling piece and went below zero
+// after a few lines anyway
+const float startTR = 0.25f;
+
+// how long you have to stop touching things before a grounded piece locks
+const float lockDelay = 1.f;
+
+enum class InputAction {
+  None,
+  Left,
+  Right,
+  Rotate,
+  Down,
+  Drop,
+};
+
+const int spawn_x = 1;
+const int spawn_y = 1;
+// Only the first 6 of the 7 shapes spawn. Thats on purpose, the original
+// picked with rand() % 6 and the bot weights and replays expect the same deal
+const int num_spawn_types = 6;
+
+struct Piece {
+  int type;
+  int angle;
+  int x;
+  int y;
+
+  [[nodiscard]] const PieceShape &shape() const {
+    return piece_shape(type, angle);
+  }
+};
+
+// The falling piece as the systems see it, kept out of the ecs so moving it
+// is a few ints instead of an entity query and float positions
+struct ActivePiece {
+  Piece piece{};
+  bool active = false;
+  // bumped on every spawn so anything holding on to one can tell it locked
+  unsigned serial = 0;
+  // seconds since any button was held, a grounded piece locks past
+  // lockDelay
+  float lock_timer = 0.f;
+
+  // where a hard drop would put it, see landing_row() in systems.h
+  struct Landing {
+    bool valid = false;
+    int x = 0;
+    int angle = 0;
+    int from_y = 0;
+    int row = 0;
+    unsigned grid_version = 0;
+    unsigned index_version = 0;
+  };
+  Landing landing;
+};
+static_assert(std::is_trivially_copyable_v<ActivePiece>,
+              "the piece should be plain data");
+
+// collides is anything callable as bool(const PieceShape &, int x, int y)
+
+template <typename Collides>
+bool try_shift(Piece &piece, int dx, int dy, Collides &&collides) {
+  if (collides(piece.shape(), piece.x + dx, piece.y + dy))
+    return false;
+  piece.x += dx;
+  piece.y += dy;
+  return true;
+}
+
+// SRS, try the plain rotation first then each kick in order
+template <typename Collides>
+bool try_rotate(Piece &piece, Collides &&collides) {
+  int new_angle = (piece.angle + 1) % num_angles;
+  const PieceShape &shape = piece_shape(piece.type, new_angle);
+
+  if (!collides(shape, piece.x, piece.y)) {
+    piece.angle = new_angle;
+    return true;
+  }
+
+  for (Cell kick : shape.kicks) {
+    if (collides(shape, piece.x + kick.x, piece.y + kick.y))
+      continue;
+    piece.angle = new_angle;
+    piece.x += kick.x;
+    piece.y += kick.y;
+    return true;
+  }
+  return false;
+}
+
+// how many rows the piece can fall before it hits something
+template <typename Collides>
+int drop_distance(const Piece &piece, Collides &&collides) {
+  int d = 0;
+  while (d <= Board::rows_h &&
+         !collides(piece.shape(), piece.x, piece.y + d + 1)) {
+    d++;
+  }
+  return d;
+}
+
+// The row a hard drop puts the piece on
+// uses the column heights and only searches when the piece is tucked under
+// an overhang, `also` is any extra board of obstacles
+template <typename B, typename Collides>
+int find_landing_row(const Piece &piece, const B &board,
+                     const std::type_identity_t<B> *also,
+                     Collides &&collides) {
+  int row = board.landing_row(piece.shape().mask, piece.x, piece.y, also);
+  if (row >= 0)
+    return row;
+  return piece.y + drop_distance(piece, collides);
+}
+
+// what a line clear did, for scoring and effects to read
+struct LineClear {
+  RowSet rows = 0;
+  int count = 0;
+};
+
+// Removes every full row out of `candidates`, pass the rows touched by the
+// last lock since no other row can have filled up
+template <typename B>
+LineClear clear_full_rows(B &board, RowSet candidates = B::all_rows) {
+  LineClear clear;
+  clear.rows = board.full_rows(candidates);
+  clear.count = __builtin_popcountll(clear.rows);
+  board.clear_rows(clear.rows);
+  return clear;
+}
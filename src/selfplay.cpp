@@ -0,0 +1,136 @@
+#include "std_include.h"
+//
+#include <thread>
+
+#include "bot.h"
+#include "sim.h"
+
+// The bot playing lots of games at once, for tuning its weights
+//
+//   ./tetr_selfplay.exe [games] [threads] [seed] [max_pieces] [weights]
+//
+// weights is "height,lines,holes,bumpiness" and defaults to bot::Weights.
+// threads of 0 is one per core
+//
+// Every game is a Sim with its own Rng split off of `seed` up front, so game
+// i deals the same pieces no matter which thread ran it or how many there
+// were. A game that reaches max_pieces without topping out counts as survived
+
+struct GameResult {
+  int pieces = 0;
+  int lines = 0;
+  long frames = 0;
+  bool survived = false;
+};
+
+GameResult play(Rng rng, int max_pieces, const bot::Weights &weights) {
+  const float dt = tick_dt;
+
+  Sim sim(rng);
+  bot::Config config;
+  config.weights = weights;
+  // the games are already one per thread
+  config.threads = 1;
+  bot::Player player(config);
+
+  GameResult result;
+  while (!sim.game_over && sim.pieces_placed < max_pieces) {
+    InputAction action = InputAction::None;
+    if (sim.has_piece)
+      action = player.act(sim.piece, sim.next_type, sim.board, sim.ground,
+                          (unsigned)sim.pieces_placed);
+    sim.step(inputs_for(action), dt);
+    result.frames++;
+  }
+  result.pieces = sim.pieces_placed;
+  result.lines = sim.lines_cleared;
+  result.survived = !sim.game_over;
+  return result;
+}
+
+bot::Weights parse_weights(const char *arg) {
+  bot::Weights w;
+  if (std::sscanf(arg, "%f,%f,%f,%f", &w.height, &w.lines, &w.holes,
+                  &w.bumpiness) != 4) {
+    std::cerr << "weights should look like -0.51,0.76,-0.36,-0.18"
+              << std::endl;
+    std::exit(1);
+  }
+  return w;
+}
+
+int main(int argc, char **argv) {
+  int games = argc > 1 ? std::atoi(argv[1]) : 64;
+  int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+  uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+  int max_pieces = argc > 4 ? std::atoi(argv[4]) : 1000;
+  bot::Weights weights = argc > 5 ? parse_weights(argv[5]) : bot::Weights{};
+  // the averages below divide by it, and atoi gives 0 for garbage too
+  if (games <= 0) {
+    std::cerr << "games should be at least 1" << std::endl;
+    return 1;
+  }
+
+  if (threads <= 0)
+    threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, games);
+
+  std::vector<Rng> streams;
+  Rng root(seed);
+  for (int i = 0; i < games; i++)
+    streams.push_back(root.split());
+
+  // each worker grabs the next game until theyre gone
+  std::vector<GameResult> results((size_t)games);
+  std::atomic<int> next_game = 0;
+  auto worker = [&] {
+    for (int i = next_game++; i < games; i = next_game++)
+      results[(size_t)i] = play(streams[(size_t)i], max_pieces, weights);
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++)
+    pool.emplace_back(worker);
+  for (auto &t : pool)
+    t.join();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  long pieces = 0;
+  long lines = 0;
+  long frames = 0;
+  int survived = 0;
+  int min_lines = std::numeric_limits<int>::max();
+  int max_lines = 0;
+  long topped_out_pieces = 0;
+  for (const GameResult &r : results) {
+    pieces += r.pieces;
+    lines += r.lines;
+    frames += r.frames;
+    min_lines = std::min(min_lines, r.lines);
+    max_lines = std::max(max_lines, r.lines);
+    if (r.survived)
+      survived++;
+    else
+      topped_out_pieces += r.pieces;
+  }
+
+  std::cout << "games " << games << " on " << threads << " threads in "
+            << seconds << "s" << std::endl;
+  std::cout << "pieces " << pieces << " (" << (double)pieces / seconds
+            << "/s, " << (double)pieces / seconds / threads
+            << "/s per thread) frames " << frames << std::endl;
+  std::cout << "lines " << lines << " mean "
+            << (double)lines / (double)games << " min " << min_lines
+            << " max " << max_lines << std::endl;
+  std::cout << "survived " << survived << "/" << games << " to "
+            << max_pieces << " pieces";
+  if (survived < games)
+    std::cout << ", the rest lasted "
+              << (double)topped_out_pieces / (double)(games - survived)
+              << " pieces on average";
+  std::cout << std::endl;
+  return 0;
+}
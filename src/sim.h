@@ -0,0 +1,113 @@
+#pragma once
+
+#include "controls.h"
+#include "rng.h"
+#include "rules.h"
+
+// The whole game with no window, gl context or ecs
+//
+// step() is one tick of the update systems registered in main(), in the
+// same order and with the same handling, so it plays like the real thing
+// just as fast as the cpu will go
+struct Sim {
+  Board board;
+  // stands in for the pieces SpawnGround puts along the bottom
+  Board ground;
+
+  Piece piece{};
+  bool has_piece = false;
+  int next_type;
+  Rng rng;
+
+  // rows touched by locks since ClearLine last looked
+  RowSet dirty_rows = 0;
+  LineClear last_clear;
+
+  int lines_cleared = 0;
+  int pieces_placed = 0;
+  bool game_over = false;
+
+  float since_last_input = 0.f;
+
+  // HandleInput
+  Controls controls;
+  SimInputs last_inputs;
+
+  // Fall
+  float fall_timer = startTR;
+
+  explicit Sim(uint64_t seed) : Sim(Rng(seed)) {}
+
+  explicit Sim(Rng r) : rng(r) {
+    next_type = rng.next_int(num_spawn_types);
+    for (int i = 0; i < map_w; i += 4)
+      ground.lock(piece_shape(0, 0).mask, i, map_h - 1);
+  }
+
+  [[nodiscard]] bool collides(const PieceShape &shape, int x, int y) const {
+    return board.collides(shape.mask, x, y) ||
+           ground.collides(shape.mask, x, y);
+  }
+
+  void step(const SimInputs &inputs, float dt) {
+    if (game_over)
+      return;
+
+    auto coll = [this](const PieceShape &shape, int x, int y) {
+      return collides(shape, x, y);
+    };
+
+    since_last_input = inputs.any() ? 0.f : since_last_input + dt;
+
+    // SpawnPieceIfNoneFalling
+    if (!has_piece) {
+      piece = Piece{next_type, 0, spawn_x, spawn_y};
+      has_piece = true;
+      next_type = rng.next_int(num_spawn_types);
+      if (coll(piece.shape(), piece.x, piece.y)) {
+        game_over = true;
+        return;
+      }
+    }
+
+    // HandleInput, the same events the system makes off the collector
+    InputQueue queue;
+    queue.push_changes(last_inputs, inputs, 0.);
+    last_inputs = inputs;
+    TickActions actions = controls.update(queue, dt);
+    apply_actions(piece, actions, coll);
+    if (actions.drop) {
+      // has_piece is always true here, spawn either made one or ended it
+      piece.y = find_landing_row(piece, board, &ground, coll);
+      lock();
+    }
+
+    // Fall
+    if (fall_timer < 0) {
+      fall_timer = startTR;
+      if (has_piece && !try_shift(piece, 0, 1, coll) &&
+          since_last_input > lockDelay) {
+        lock();
+      }
+    } else {
+      fall_timer -= dt;
+    }
+
+    // ClearLine
+    if (dirty_rows) {
+      LineClear clear = clear_full_rows(board, dirty_rows);
+      dirty_rows = 0;
+      if (clear.count > 0) {
+        last_clear = clear;
+        lines_cleared += clear.count;
+      }
+    }
+  }
+
+private:
+  void lock() {
+    dirty_rows |= board.lock(piece.shape().mask, piece.x, piece.y);
+    has_piece = false;
+    pieces_placed++;
+  }
+};
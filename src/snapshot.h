@@ -0,0 +1,76 @@
+#pragma once
+// not a real header, pasted into game.h after systems.h
+
+// The whole running game as one trivially copyable value
+//
+// A Snapshot is a Sim, so a copy plays on by itself with no ECS at all:
+// save once, copy it as many times as you like and step each copy, thats
+// forking the game for search or what-if evaluation. restore_game puts one
+// back into the real game for rollback or jumping around a replay
+//
+// Everything that decides how the game goes from here is in it: the Grid,
+// NextPieceHolder, active_piece and tick_state (the HandleInput and Fall
+// timers). Saving is plain field copies, a few hundred bytes, restoring is
+// the same plus a new entity for the falling piece. What isnt in it:
+//  - the ground, it never changes. save fills it in from collision_index so
+//    a fork collides the same, restore leaves the entities alone
+//  - Handling, thats a setting, restore keeps the current one
+//  - the view entity and caches, restore makes a fresh view and bumps
+//    Grid::version so everything keyed on it (landing rows, the grid
+//    texture, the bot's plan) starts over
+using Snapshot = Sim;
+
+void save_game(Snapshot &out) {
+  const Grid &gridC = Grid::get();
+  const NextPieceHolder &nph = NextPieceHolder::get();
+
+  out.board = gridC.board;
+  out.ground = collision_index.cells;
+  out.dirty_rows = gridC.dirty_rows;
+  out.last_clear = gridC.last_clear;
+  out.lines_cleared = gridC.totalCleared;
+  out.pieces_placed = gridC.pieces_placed;
+  // the window version keeps spawning into a full board
+  out.game_over = false;
+
+  out.next_type = nph.next_type;
+  out.rng = nph.rng;
+
+  out.piece = active_piece.piece;
+  out.has_piece = active_piece.active;
+  out.since_last_input = active_piece.lock_timer;
+
+  out.controls = tick_state.controls;
+  out.last_inputs = tick_state.last_inputs;
+  out.fall_timer = tick_state.fall_timer;
+}
+
+void restore_game(const Snapshot &snap) {
+  Grid &gridC = Grid::get();
+  NextPieceHolder &nph = NextPieceHolder::get();
+
+  gridC.board = snap.board;
+  gridC.dirty_rows = snap.dirty_rows;
+  gridC.last_clear = snap.last_clear;
+  gridC.totalCleared = snap.lines_cleared;
+  gridC.pieces_placed = snap.pieces_placed;
+  gridC.version++;
+
+  nph.next_type = snap.next_type;
+  nph.rng = snap.rng;
+
+  active_piece.piece = snap.piece;
+  active_piece.active = snap.has_piece;
+  active_piece.lock_timer = snap.since_last_input;
+  active_piece.landing.valid = false;
+  if (active_piece.active)
+    make_falling_view(active_piece);
+  else
+    active_piece.serial++;
+
+  Handling handling = tick_state.controls.handling;
+  tick_state.controls = snap.controls;
+  tick_state.controls.handling = handling;
+  tick_state.last_inputs = snap.last_inputs;
+  tick_state.fall_timer = snap.fall_timer;
+}
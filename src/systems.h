@@ -6,269 +6,285 @@
 #include "piece_data.h"
 #include "raylib.h"
 
-bool will_collide(EntityID id, vec2 pos, const std::array<int, 16> &shape) {
-
-  OptEntity opt_grid = EQ().whereHasComponent<Grid>().gen_first();
-  Grid &gridC = opt_grid.asE().get<Grid>();
-
-  auto pips = get_pips(pos, shape);
-  for (auto &pip : pips) {
-    // check inside map
-    if (pip.x < 0 || pip.x > (map_w - 1) * sz)
-      return true;
-    // check if locked
-    if (gridC.grid[(size_t)(pip.x / sz)][(size_t)(pip.y / sz)] > 0)
-      return true;
-  }
+bool piece_collides(const PieceShape &shape, int x, int y) {
+  Grid &gridC = Grid::get();
+
+  // walls, floor and locked cells
+  if (gridC.board.collides(shape.mask, x, y))
+    return true;
 
   // check ground
-  return EQ()
-      .whereNotID(id)
-      .whereHasComponent<HasCollision>()
-      .whereHasComponent<Transform>()
-      .whereOverlaps(pos, shape)
-      .has_values();
+  // the falling piece isnt in the index so it cant hit itself
+  return collision_index.collides(shape.mask, x, y);
 }
 
-void lock_entity(Entity &entity, const vec2 &pos,
-                 const std::array<int, 16> &sh) {
-  entity.removeComponent<IsFalling>();
-  entity.cleanup = true;
-
-  OptEntity opt_grid = EQ().whereHasComponent<Grid>().gen_first();
-  Grid &gridC = opt_grid.asE().get<Grid>();
-
-  const auto &pips = get_pips(pos, sh);
-  for (auto &pip : pips) {
-    size_t i = (size_t)(pip.x / sz);
-    size_t j = (size_t)(pip.y / sz);
-    gridC.grid[i][j] = 1;
-  }
+bool will_collide(vec2 pos, const PieceShape &shape) {
+  return piece_collides(shape, to_cell(pos.x), to_cell(pos.y));
 }
 
-struct ForceDrop : System<Transform, IsFalling, PieceType> {
-  float timer;
-  float timerReset;
-  ForceDrop() : timer(0), timerReset(dropReset) {}
-  virtual ~ForceDrop() {}
-
-  bool is_space = false;
-
-  virtual bool should_run(float dt) override {
-    input::PossibleInputCollector<InputAction> inpc =
-        input::get_input_collector<InputAction>();
-    if (!inpc.has_value()) {
-      return false;
-    }
-    is_space = false;
-
-    for (auto &actions_done : inpc.inputs()) {
-      switch (actions_done.action) {
-      case InputAction::Drop:
-        is_space = actions_done.amount_pressed > 0.f;
-        break;
-      default:
-        break;
-      }
-    }
+// SyncFallingView gets rid of its entity at the end of the tick
+void lock_active(ActivePiece &active) {
+  Grid &gridC = Grid::get();
+  const Piece &piece = active.piece;
+  // the record wants the board from before the lock
+  std::optional<Board> before;
+  if (dataset_writer.is_open())
+    before = gridC.board;
+
+  RowSet touched = gridC.board.lock(piece.shape().mask, piece.x, piece.y);
+  gridC.dirty_rows |= touched;
+  gridC.version++;
+  gridC.pieces_placed++;
+  active.active = false;
+
+  if (before)
+    dataset_writer.add(*before, piece, NextPieceHolder::get().next_type,
+                       __builtin_popcountll(gridC.board.full_rows(touched)));
+}
 
-    timer -= dt;
+// the ecs side of rules.h
 
-    // we should force drop
-    if (is_space && timer <= 0) {
-      timer = timerReset;
-      return true;
-    }
+Piece as_piece(const Transform &transform, const PieceType &pt) {
+  return Piece{pt.type, pt.angle, to_cell(transform.pos().x),
+               to_cell(transform.pos().y)};
+}
 
-    return false;
-  }
+void apply_piece(Transform &transform, PieceType &pt, const Piece &piece) {
+  pt.angle = piece.angle;
+  transform.update(to_pos(piece.x, piece.y));
+}
 
-  virtual void for_each_with(Entity &entity, Transform &transform, IsFalling &,
-                             PieceType &pt, float) override {
-    if (!is_space)
-      return;
-    vec2 p = transform.pos();
-    vec2 offset = vec2{0, sz};
-    while (!will_collide(entity.id, p + offset, pt.shape)) {
-      p += offset;
-    }
-    transform.update(p);
-    lock_entity(entity, p, pt.shape);
+// The row a hard drop would land the piece on
+//
+// Comes from the column heights unless the piece is under an overhang.
+// Remembered on the ActivePiece, every row between where we searched from
+// and where we landed drops to the same place so gravity doesnt throw it
+// away, only moving sideways, rotating, the grid changing or an obstacle
+// moving does
+int landing_row(ActivePiece &active) {
+  const Grid &gridC = Grid::get();
+
+  const Piece &piece = active.piece;
+  ActivePiece::Landing &landing = active.landing;
+  if (landing.valid && landing.x == piece.x && landing.angle == piece.angle &&
+      landing.grid_version == gridC.version &&
+      landing.index_version == collision_index.version &&
+      landing.from_y <= piece.y && piece.y <= landing.row) {
+    return landing.row;
   }
-};
-
-struct Move : System<Transform, IsFalling, PieceType> {
-  float timer;
-  float timerReset;
-
-  bool is_left_pressed;
-  bool is_right_pressed;
-  bool is_down_pressed;
 
-  Move() : timer(keyReset), timerReset(keyReset) {}
-  virtual ~Move() {}
+  landing.valid = true;
+  landing.x = piece.x;
+  landing.angle = piece.angle;
+  landing.from_y = piece.y;
+  landing.row = find_landing_row(piece, gridC.board, &collision_index.cells,
+                                 piece_collides);
+  landing.grid_version = gridC.version;
+  landing.index_version = collision_index.version;
+  return landing.row;
+}
 
-  virtual bool should_run(float dt) override {
+// where the piece would land if you hard dropped it right now
+vec2 ghost_position(ActivePiece &active) {
+  return to_pos(active.piece.x, landing_row(active));
+}
 
-    if (timer < 0) {
-      timer = timerReset;
+// for systems that press buttons themselves, anything reading input after
+// them this frame cant tell the difference
+void push_action(input::PossibleInputCollector<InputAction> &inpc,
+                 InputAction action) {
+  using ActionDone = std::decay_t<decltype(inpc.inputs())>::value_type;
+  ActionDone done{};
+  done.action = action;
+  done.amount_pressed = 1.f;
+  inpc.inputs().push_back(done);
+}
 
-      return true;
-    }
-    timer -= dt;
+// Plays the game by pushing InputActions like a controller would
+// registered ahead of the systems that read input so they see it this frame
+struct BotPlayer : System<> {
+  bot::Player player;
 
-    is_left_pressed = false;
-    is_right_pressed = false;
-    is_down_pressed = false;
+  virtual ~BotPlayer() {}
 
+  virtual bool should_run(float) override {
     input::PossibleInputCollector<InputAction> inpc =
         input::get_input_collector<InputAction>();
-    if (!inpc.has_value()) {
+    if (!active_piece.active || !inpc.has_value() ||
+        !NextPieceHolder::exists())
       return false;
-    }
 
-    // TODO do we need to eat these?
-    for (auto &actions_done : inpc.inputs()) {
-      switch (actions_done.action) {
-      case InputAction::Left:
-        is_left_pressed = actions_done.amount_pressed > 0.f;
-        break;
-      case InputAction::Right:
-        is_right_pressed = actions_done.amount_pressed > 0.f;
-        break;
-      case InputAction::Down:
-        is_down_pressed = actions_done.amount_pressed > 0.f;
-        break;
-      default:
-        break;
-      }
-    }
+    // grid version bumps on every lock, so a new version is a new piece
+    const Grid &gridC = Grid::get();
+    InputAction action =
+        player.act(active_piece.piece, NextPieceHolder::get().next_type,
+                   gridC.board, collision_index.cells, gridC.version);
+    if (action != InputAction::None)
+      push_action(inpc, action);
     return false;
   }
+};
 
-  virtual void for_each_with(Entity &entity, Transform &transform, IsFalling &,
-                             PieceType &pt, float) override {
+// Writes down what was held every frame, see replay.h
+// registered after anything that pushes inputs so it records those too
+struct RecordInputs : System<> {
+  replay::Recorder &recorder;
 
-    vec2 p = transform.pos();
-    if (is_left_pressed)
-      p -= vec2{sz, 0};
-    if (is_right_pressed)
-      p += vec2{sz, 0};
-    if (is_down_pressed)
-      p += vec2{0, sz};
+  explicit RecordInputs(replay::Recorder &r) : recorder(r) {}
+  virtual ~RecordInputs() {}
 
-    if (will_collide(entity.id, p, pt.shape)) {
-      return;
-    }
-    transform.update(p);
+  virtual bool should_run(float) override {
+    input::PossibleInputCollector<InputAction> inpc =
+        input::get_input_collector<InputAction>();
+    SimInputs held;
+    if (inpc.has_value())
+      for (auto &actions_done : inpc.inputs())
+        if (actions_done.amount_pressed > 0.f)
+          hold(held, actions_done.action);
+    recorder.record(held);
+    return false;
   }
 };
 
-struct Rotate : System<Transform, IsFalling, PieceType> {
-  float timer;
-  float timerReset;
-
-  bool is_up_pressed;
+// Swaps whatever was pressed for what the replay held on this frame
+struct ReplayInputs : System<> {
+  replay::Replay log;
+  replay::Player player;
 
-  Rotate() : timer(rotateReset), timerReset(rotateReset) {}
-  virtual ~Rotate() {}
-
-  virtual bool should_run(float dt) override {
-    if (timer < 0) {
-      timer = timerReset;
-      return true;
-    }
-    timer -= dt;
-    is_up_pressed = false;
+  explicit ReplayInputs(replay::Replay r) : log(std::move(r)), player(log) {}
+  virtual ~ReplayInputs() {}
 
+  virtual bool should_run(float) override {
     input::PossibleInputCollector<InputAction> inpc =
         input::get_input_collector<InputAction>();
-    if (!inpc.has_value()) {
+    if (!inpc.has_value() || player.done())
       return false;
-    }
 
-    for (auto &actions_done : inpc.inputs()) {
-      switch (actions_done.action) {
-      case InputAction::Rotate:
-        is_up_pressed = actions_done.amount_pressed > 0.f;
-        break;
-      default:
-        break;
-      }
-    }
+    SimInputs held = player.next();
+    inpc.inputs().clear();
+    if (held.left)
+      push_action(inpc, InputAction::Left);
+    if (held.right)
+      push_action(inpc, InputAction::Right);
+    if (held.down)
+      push_action(inpc, InputAction::Down);
+    if (held.rotate)
+      push_action(inpc, InputAction::Rotate);
+    if (held.drop)
+      push_action(inpc, InputAction::Drop);
+    if (player.done())
+      std::cout << "replay finished" << std::endl;
     return false;
   }
+};
 
-  virtual void for_each_with(Entity &entity, Transform &transform, IsFalling &,
-                             PieceType &pt, float) override {
-    if (!is_up_pressed) {
-      return;
-    }
-
-    vec2 pos = transform.pos();
-    auto new_angle = (pt.angle + 1) % 4;
-    auto new_shape = type_to_rotated_array(pt.type, new_angle);
-
-    // no collision?
-    if (!will_collide(entity.id, pos, new_shape)) {
-      pt.angle = new_angle;
-      pt.shape = new_shape;
-      return;
-    }
+// first thing every tick, so the renderer knows where things moved from
+struct StartTick : System<Transform> {
+  virtual ~StartTick() {}
+  virtual void for_each_with(Entity &, Transform &transform, float) override {
+    transform.start_tick();
+  }
+};
 
-    // rotation didnt fit,
-    // wall kick
+// Every button that went down or up since last tick, as events
+//
+// afterhours only tells us what is held right now so the edges come from
+// diffing that against last tick. Everything that was pressed gets handled
+// this tick, including the first shift of a left/right, only the repeats
+// after that wait on the das/arr timers
+struct HandleInput : System<> {
+  // the timers and last tick's buttons are in tick_state
+  InputQueue queue;
+  TickActions actions;
+
+  explicit HandleInput(Handling handling = Handling{}) {
+    tick_state.controls.handling = handling;
+  }
+  virtual ~HandleInput() {}
 
-    std::array<std::array<std::pair<int, int>, 4>, 4> tests =
-        pt.type == 0 ? long_boi_tests : wall_kick_tests;
+  virtual bool should_run(float dt) override {
+    SimInputs now;
+    input::PossibleInputCollector<InputAction> inpc =
+        input::get_input_collector<InputAction>();
+    if (inpc.has_value())
+      for (auto &actions_done : inpc.inputs())
+        if (actions_done.amount_pressed > 0.f)
+          hold(now, actions_done.action);
+
+    queue.clear();
+    queue.push_changes(tick_state.last_inputs, now, raylib::GetTime());
+    tick_state.last_inputs = now;
+    // the timers run even with no piece so a held key keeps repeating
+    // into the next one
+    actions = tick_state.controls.update(queue, dt);
+    if (!active_piece.active || !actions.any())
+      return false;
 
-    for (auto pair : tests[(size_t)new_angle]) {
-      vec2 offset = vec2{pair.first * sz, pair.second * sz};
-      if (will_collide(entity.id, pos + offset, new_shape))
-        continue;
-      pt.angle = new_angle;
-      pt.shape = new_shape;
-      transform.update(pos + offset);
-      return;
+    bool moved = apply_actions(active_piece.piece, actions, piece_collides);
+    if (actions.drop) {
+      active_piece.piece.y = landing_row(active_piece);
+      lock_active(active_piece);
     }
+    if (moved || actions.drop)
+      input_latency.moved(actions.pressed_at);
+    return false;
   }
 };
 
-struct Fall : System<Transform, IsFalling, PieceType> {
-  float timer;
-  float timerReset;
-  Fall() : timer(TR), timerReset(TR) {}
-
+// gravity, a row every startTR however many lines have been cleared
+struct Fall : System<> {
+  // the timer itself is tick_state.fall_timer
   virtual ~Fall() {}
 
   virtual bool should_run(float dt) override {
-    if (timer < 0) {
-      timer = timerReset;
-      return true;
+    input::PossibleInputCollector<InputAction> inpc =
+        input::get_input_collector<InputAction>();
+    bool any = false;
+    if (inpc.has_value())
+      for (auto &actions_done : inpc.inputs())
+        any |= actions_done.amount_pressed > 0.f;
+    // Counted off of the InputActions instead of the collector's own
+    // timer, that one only sees real devices and not what a bot or replay
+    // pushed
+    active_piece.lock_timer = any ? 0.f : active_piece.lock_timer + dt;
+
+    float &timer = tick_state.fall_timer;
+    if (timer >= 0) {
+      timer -= dt;
+      return false;
     }
-    timer -= dt;
-    return false;
-  }
-
-  virtual void for_each_with(Entity &entity, Transform &transform, IsFalling &,
-                             PieceType &pt, float) override {
-    auto p = transform.pos() + vec2{0, sz};
-    if (will_collide(entity.id, p, pt.shape)) {
+    timer = startTR;
+    if (!active_piece.active)
+      return false;
 
+    if (!try_shift(active_piece.piece, 0, 1, piece_collides)) {
       // In the situation where it will collide but you could rotate and keep
       // going, lets wait a bit if the user is trying to rotate
+      if (active_piece.lock_timer > lockDelay)
+        lock_active(active_piece);
+    }
+    return false;
+  }
+};
 
-      input::PossibleInputCollector<InputAction> inpc =
-          input::get_input_collector<InputAction>();
-      if (inpc.has_value() && inpc.since_last_input() > 1.f) {
-        lock_entity(entity, transform.pos(), pt.shape);
-      }
-
+// Copies active_piece onto the entity that draws it, last thing every tick
+// so it only happens once however many systems moved the piece
+struct SyncFallingView : System<Transform, IsFalling, PieceType> {
+  virtual ~SyncFallingView() {}
+
+  virtual void for_each_with(Entity &entity, Transform &transform,
+                             IsFalling &falling, PieceType &pt,
+                             float) override {
+    if (!active_piece.active || falling.serial != active_piece.serial) {
+      // locked, its cells are in the grid now
+      entity.removeComponent<IsFalling>();
+      entity.cleanup = true;
       return;
     }
-    //
-    //
-    transform.update(p);
+    const Piece &piece = active_piece.piece;
+    if (pt.angle != piece.angle || to_cell(transform.pos().x) != piece.x ||
+        to_cell(transform.pos().y) != piece.y)
+      apply_piece(transform, pt, piece);
   }
 };
 
@@ -276,53 +292,106 @@ struct ClearLine : System<Grid> {
   virtual ~ClearLine() {}
   virtual void for_each_with(Entity &, Grid &gridC, float) override {
 
-    auto &grid = gridC.grid;
-
-    for (size_t j = 0; j < map_h; j++) {
-
-      int sum = 0;
-      for (size_t i = 0; i < map_w; i++)
-        if (grid[i][j] > 0)
-          sum++;
-
-      if (sum != map_w)
-        continue;
+    // nothing locked since last time so nothing can be full
+    if (gridC.dirty_rows == 0)
+      return;
 
-      // clear row()
-      for (size_t i = 0; i < map_w; i++)
-        grid[i][j] = 0;
+    LineClear clear = clear_full_rows(gridC.board, gridC.dirty_rows);
+    gridC.dirty_rows = 0;
+    if (clear.count == 0)
+      return;
 
-      // move everything above down
-      for (size_t k = j; k > 0; k--) {
-        for (size_t i = 0; i < map_w; i++)
-          grid[i][k] = grid[i][k - 1];
-      }
+    gridC.last_clear = clear;
+    gridC.version++;
 
-      // replace top row with empty tiles
-      for (size_t i = 0; i < map_w; i++)
-        grid[i][0] = 0;
+    gridC.totalCleared += clear.count;
+  }
+};
 
-      // Increment num lines and speed up game
-      gridC.totalCleared++;
+void push_cell(vec2 pos, raylib::Color col, Layer layer,
+               RenderBuffer &buffer = render_buffer) {
+  buffer.push(Quad{pos.x, pos.y, sz * szm, sz * szm,
+                   Rgba{col.r, col.g, col.b, col.a}, layer});
+}
 
-      // speed up
-      TR -= 0.1f;
+// sends each batch as a single run of quads, rlgl keeps them all in one
+// draw call as long as nothing else changes state in between
+//
+// rlBegin keeps whatever texture the last draw left bound (the font after
+// DrawText, the grid after RenderGrid), so bind the default 1x1 white one
+// and give every vertex a texcoord on it, the same as raylib's own shapes
+struct RaylibBackend {
+  void draw_batch(Rgba col, const Quad *quads, size_t n) {
+    raylib::rlCheckRenderBatchLimit((int)n * 4);
+    raylib::rlSetTexture(raylib::rlGetTextureIdDefault());
+    raylib::rlBegin(RL_QUADS);
+    raylib::rlColor4ub(col.r, col.g, col.b, col.a);
+    for (size_t i = 0; i < n; i++) {
+      const Quad &q = quads[i];
+      raylib::rlTexCoord2f(0.f, 0.f);
+      raylib::rlVertex2f(q.x, q.y);
+      raylib::rlTexCoord2f(0.f, 1.f);
+      raylib::rlVertex2f(q.x, q.y + q.h);
+      raylib::rlTexCoord2f(1.f, 1.f);
+      raylib::rlVertex2f(q.x + q.w, q.y + q.h);
+      raylib::rlTexCoord2f(1.f, 0.f);
+      raylib::rlVertex2f(q.x + q.w, q.y);
     }
+    raylib::rlEnd();
+    raylib::rlSetTexture(0);
   }
 };
 
+void push_grid(const Grid &gridC, RenderBuffer &buffer) {
+  for (int i = 0; i < map_w; i++) {
+    for (int j = 0; j < map_h; j++) {
+      bool val = gridC.board.is_set(i, j);
+      push_cell(to_pos(i, j), val ? color::BLACK : color::GRAY_,
+                Layer::Board, buffer);
+    }
+  }
+}
+
+// The locked cells only change when something locks or clears, so they get
+// drawn into a texture once per grid version and every other frame is just
+// the one texture draw
+//
+// the texture isnt unloaded, the systems outlive CloseWindow and it goes
+// away with the gl context anyway
 struct RenderGrid : System<Grid> {
+  mutable raylib::RenderTexture2D target{};
+  mutable bool has_target = false;
+  mutable unsigned drawn_version = 0;
+  mutable RenderBuffer cells;
+
   virtual ~RenderGrid() {}
+
+  void redraw(const Grid &gridC) const {
+    push_grid(gridC, cells);
+    raylib::BeginTextureMode(target);
+    raylib::ClearBackground(color::BLACK_);
+    RaylibBackend backend;
+    cells.flush(backend);
+    raylib::EndTextureMode();
+    drawn_version = gridC.version;
+  }
+
   virtual void for_each_with(const Entity &, const Grid &gridC,
                              float) const override {
-    vec2 size = {sz * szm, sz * szm};
-    for (size_t i = 0; i < map_w; i++) {
-      for (size_t j = 0; j < map_h; j++) {
-        int val = gridC.grid[i][j];
-        raylib::DrawRectangleV({(i * sz), (j * sz)}, size,
-                               val == 0 ? color::GRAY_ : color::BLACK);
-      }
+    if (!has_target) {
+      target = raylib::LoadRenderTexture((int)(map_w * sz), (int)(map_h * sz));
+      has_target = true;
+      redraw(gridC);
+    } else if (drawn_version != gridC.version) {
+      redraw(gridC);
     }
+
+    // render textures are stored upside down, hence the negative height
+    raylib::Rectangle source = {0, 0, (float)target.texture.width,
+                                -(float)target.texture.height};
+    // the pieces flushed after this are plain quads, RaylibBackend binds
+    // the default texture for them so they dont pick this one up
+    raylib::DrawTextureRec(target.texture, source, {0, 0}, raylib::WHITE);
   }
 };
 
@@ -335,16 +404,9 @@ struct RenderPiece : System<Transform, PieceType> {
                             ? color::BLACK_
                             : color::piece_color(pieceType.type);
 
-    for (size_t i = 0; i < 4; i++) {
-      for (size_t j = 0; j < 4; j++) {
-        if (pieceType.shape[j * 4 + i] == 0)
-          continue;
-        raylib::DrawRectangleV(
-            {transform.pos().x + (i * sz), transform.pos().y + (j * sz)},
-            {sz * szm, sz * szm},
-
-            col);
-      }
+    vec2 p = transform.interpolated(render_alpha);
+    for (Cell c : pieceType.shape().cells) {
+      push_cell({p.x + (c.x * sz), p.y + (c.y * sz)}, col, Layer::Piece);
     }
   }
 };
@@ -354,65 +416,59 @@ struct RenderPreview : System<NextPieceHolder> {
   virtual void for_each_with(const Entity &, const NextPieceHolder &nph,
                              float) const override {
     vec2 p = {260, 60};
-    auto shape = type_to_rotated_array(nph.next_type, 0);
+    const PieceShape &shape = piece_shape(nph.next_type, 0);
     raylib::Color color = color::piece_color(nph.next_type);
 
     raylib::DrawText("Next Piece", (int)p.x, (int)(p.y - (2 * sz)), (int)sz,
                      raylib::RAYWHITE);
 
-    for (size_t i = 0; i < 4; i++) {
-      for (size_t j = 0; j < 4; j++) {
-        if (shape[j * 4 + i] == 0)
-          continue;
-        raylib::DrawRectangleV({p.x + (i * sz), p.y + (j * sz)},
-                               {sz * szm, sz * szm}, color);
-      }
+    for (Cell c : shape.cells) {
+      push_cell({p.x + (c.x * sz), p.y + (c.y * sz)}, color, Layer::Ui);
     }
   }
 };
-struct RenderGhost : System<Transform, IsFalling, PieceType> {
+
+struct RenderGhost : System<IsFalling, PieceType> {
   virtual ~RenderGhost() {}
-  virtual void for_each_with(const Entity &entity, const Transform &transform,
-                             const IsFalling &, const PieceType &pt,
-                             float) const override {
-    vec2 p = transform.pos();
-    vec2 offset = vec2{0, sz};
-    while (!will_collide(entity.id, p + offset, pt.shape)) {
-      if (p.y > map_h * sz)
-        break;
-      p += offset;
-    }
+  virtual void for_each_with(const Entity &, const IsFalling &falling,
+                             const PieceType &pt, float) const override {
+    if (falling.serial != active_piece.serial)
+      return;
+    vec2 p = ghost_position(active_piece);
 
     raylib::Color color = color::piece_color(pt.type);
     color.a = 100;
 
-    for (size_t i = 0; i < 4; i++) {
-      for (size_t j = 0; j < 4; j++) {
-        if (pt.shape[j * 4 + i] == 0)
-          continue;
-        raylib::DrawRectangleV({p.x + (i * sz), p.y + (j * sz)},
-                               {sz * szm, sz * szm}, color);
-      }
+    for (Cell c : pt.shape().cells) {
+      push_cell({p.x + (c.x * sz), p.y + (c.y * sz)}, color, Layer::Ghost);
     }
   }
 };
 
+// A new entity to draw `active` with, it gets a new serial so whatever
+// view was up before cleans itself up in SyncFallingView
+Entity &make_falling_view(ActivePiece &active) {
+  active.serial++;
+  auto &entity = EntityHelper::createEntity();
+  entity.addComponent<Transform>(to_pos(active.piece.x, active.piece.y));
+  entity.addComponent<IsFalling>(active.serial);
+  entity.addComponent<PieceType>(active.piece.type);
+  entity.get<PieceType>().angle = active.piece.angle;
+  return entity;
+}
+
 struct SpawnPieceIfNoneFalling : System<NextPieceHolder> {
   virtual ~SpawnPieceIfNoneFalling() {}
 
-  virtual bool should_run(float) override {
-    return !EQ().whereHasComponent<IsFalling>().has_values();
-  }
+  virtual bool should_run(float) override { return !active_piece.active; }
 
   virtual void for_each_with(Entity &, NextPieceHolder &nph, float) override {
+    active_piece.piece = Piece{nph.next_type, 0, spawn_x, spawn_y};
+    active_piece.active = true;
+    active_piece.landing.valid = false;
+    Entity &entity = make_falling_view(active_piece);
 
-    auto &entity = EntityHelper::createEntity();
-    entity.addComponent<Transform>(vec2{20, 20});
-    entity.addComponent<IsFalling>();
-    entity.addComponent<HasCollision>();
-    entity.addComponent<PieceType>(nph.next_type);
-
-    nph.next_type = (rand() % 6);
+    nph.next_type = nph.rng.next_int(num_spawn_types);
 
     std::cout << "spawned piece of type " << entity.get<PieceType>().type
               << std::endl;
@@ -432,6 +488,7 @@ struct SpawnGround : System<> {
         entity.addComponent<IsGround>();
         entity.addComponent<HasCollision>();
         entity.addComponent<PieceType>(0);
+        entity.get<Transform>().index_as(piece_shape(0, 0).mask);
       }
     }
     return false;